@@ -19,12 +19,26 @@ enum class AnimIteration
 	UNKNOWN
 };
 
+// Playback state of an Animation, plain data for snapshots
+struct AnimationState
+{
+	float timeSinceLastFunctionCall = 0;
+	float speed = 0;
+	float currentFrame = 0;
+	AnimIteration animStyle = AnimIteration::NEVER;
+	bool bActive = false;
+	bool bFinished = false;
+	uint loopsToDo = 0;
+};
+
 class Animation
 {
 public:
 
 	Animation() = default;
 
+	explicit Animation(App* app) : app(app) {}
+
 	~Animation() = default;
 
 	SDL_Texture *GetCurrentFrame()
@@ -91,15 +105,16 @@ public:
 			return frames[(int)currentFrame];
 	}
 
+	// Without Textures (headless) frames are still counted so the animation timing stays the same
 	Animation *AddStaticImage(const char *pathToPNG)
 	{
-		staticImage = app->tex->Load(pathToPNG);
+		staticImage = app->tex ? app->tex->Load(pathToPNG) : nullptr;
 		return this;
 	}
 
 	Animation* AddSingleFrame(const char* pathToPNG)
 	{
-		frames.push_back(app->tex->Load(pathToPNG));
+		frames.push_back(app->tex ? app->tex->Load(pathToPNG) : nullptr);
 		return this;
 	}
 
@@ -111,6 +126,7 @@ public:
 
 	bool CleanUp()
 	{
+		if(!app->tex) return true;
 		for(auto &elem : frames) app->tex->UnLoad(elem);
 		if(staticImage) app->tex->UnLoad(staticImage);
 		return true;
@@ -188,6 +204,30 @@ public:
 		return (uint)currentFrame == frames.size() - 1;
 	}
 
+	AnimationState GetState() const
+	{
+		AnimationState state;
+		state.timeSinceLastFunctionCall = TimeSinceLastFunctionCall;
+		state.speed = speed;
+		state.currentFrame = currentFrame;
+		state.animStyle = animStyle;
+		state.bActive = bActive;
+		state.bFinished = bFinished;
+		state.loopsToDo = loopsToDo;
+		return state;
+	}
+
+	void SetState(AnimationState const &state)
+	{
+		TimeSinceLastFunctionCall = state.timeSinceLastFunctionCall;
+		speed = state.speed;
+		currentFrame = state.currentFrame;
+		animStyle = state.animStyle;
+		bActive = state.bActive;
+		bFinished = state.bFinished;
+		loopsToDo = state.loopsToDo;
+	}
+
 	void DoLoopsOfAnimation(uint loops, AnimIteration style)
 	{
 		if(loops <= 0) return;
@@ -208,5 +248,8 @@ private:
 	uint loopsToDo = 0;
 	std::vector<SDL_Texture*> frames;
 	SDL_Texture *staticImage = nullptr;
+
+	// Owner table, textures are loaded through its Textures module
+	App* app = nullptr;
 }; 
 #endif	// __ANIMATION_H__
\ No newline at end of file
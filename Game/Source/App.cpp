@@ -9,43 +9,76 @@
 #include "Map.h"
 #include "Physics.h"
 #include "Fonts.h"
+#include "Profiler.h"
+#include "PerfTimer.h"
+#include "SaveWriter.h"
+#include "Snapshot.h"
 
 #include "Defs.h"
 #include "Log.h"
 
 #include <iostream>
 #include <sstream>
+#include <cmath>
+#include <memory>
 
 // Constructor
 App::App(int argc, char* args[]) : argc(argc), args(args)
 {
 	frames = 0;
+	dt = 0.0f;
 
-	input = new Input();
-	win = new Window();
-	render = new Render();
-	tex = new Textures();
-	audio = new Audio();
-	physics = new Physics();
-	scene = new Scene();
-	entityManager = new EntityManager();
-	map = new Map();
-	fonts = new Fonts();
+	const char* scriptPath = nullptr;
+	uint scriptOffset = 0;
+
+	for(int i = 1; i < GetArgc(); i++)
+	{
+		if(strcmp(GetArgv(i), "--headless") == 0) headless = true;
+		else if(strcmp(GetArgv(i), "--frames") == 0 && GetArgv(i + 1)) maxFrames = atoi(GetArgv(++i));
+		else if(strcmp(GetArgv(i), "--quiet") == 0) quiet = true;
+		else if(strcmp(GetArgv(i), "--script") == 0 && GetArgv(i + 1)) scriptPath = GetArgv(++i);
+		else if(strcmp(GetArgv(i), "--script-offset") == 0 && GetArgv(i + 1)) scriptOffset = atoi(GetArgv(++i));
+		else if(strcmp(GetArgv(i), "--trace") == 0 && GetArgv(i + 1))
+		{
+			tracePath = GetArgv(++i);
+			traceOnExit = true;
+		}
+		else if(strcmp(GetArgv(i), "--trace-frames") == 0 && GetArgv(i + 1)) traceFrames = atoi(GetArgv(++i));
+	}
+
+	saveWriter = new SaveWriter();
+
+	profiler = new Profiler();
+	// Headless tables only pay for the profiler when a trace was asked for
+	profiler->SetEnabled(!headless || traceOnExit);
+
+	// Headless runs only simulate the table: nothing to show, play or load textures into
+	input = new Input(this);
+	if(scriptPath) input->SetScript(scriptPath, scriptOffset);
+	win = headless ? nullptr : new Window(this);
+	render = headless ? nullptr : new Render(this);
+	tex = headless ? nullptr : new Textures(this);
+	audio = headless ? nullptr : new Audio(this);
+	physics = new Physics(this);
+	scene = new Scene(this);
+	entityManager = new EntityManager(this);
+	map = new Map(this);
+	fonts = headless ? nullptr : new Fonts(this);
 
 	// Ordered for awake / Start / Update
 	// Reverse order of CleanUp
 	AddModule(input);
-	AddModule(win);
-	AddModule(tex);
-	AddModule(audio);
+	if(win) AddModule(win);
+	if(tex) AddModule(tex);
+	if(audio) AddModule(audio);
 	AddModule(physics);
 	AddModule(scene);
 	AddModule(entityManager);
 	AddModule(map);
-	AddModule(fonts);
+	if(fonts) AddModule(fonts);
 
 	// Render last to swap buffer
-	AddModule(render);
+	if(render) AddModule(render);
 }
 
 // Destructor
@@ -61,6 +94,11 @@ App::~App()
 	}
 
 	modules.Clear();
+
+	RELEASE(profiler);
+
+	// Waits for the saves still being written
+	RELEASE(saveWriter);
 }
 
 void App::AddModule(Module* module)
@@ -72,9 +110,13 @@ void App::AddModule(Module* module)
 // Called before render is available
 bool App::Awake()
 {
+	PerfTimer timer;
+	PERF_START(timer);
+
 	if(!LoadConfig()) return false;
 
 	title = configNode.child("app").child("title").child_value();
+	autosaveInterval = configNode.child("app").child("autosave").attribute("seconds").as_float();
 
 	ListItem<Module*>*item = modules.start;
 
@@ -85,12 +127,17 @@ bool App::Awake()
 		item = item->next;
 	}
 
+	PERF_PEEK(timer);
+
 	return true;
 }
 
 // Called before the first frame
 bool App::Start()
 {
+	PerfTimer timer;
+	PERF_START(timer);
+
 	ListItem<Module*>* item = modules.start;
 
 	while (item)
@@ -99,21 +146,33 @@ bool App::Start()
 		item = item->next;
 	}
 
+	PERF_PEEK(timer);
+
+	runStartCounter = SDL_GetPerformanceCounter();
+
 	return true;
 }
 
 // Called each loop iteration
 bool App::Update()
 {
+	if(paused || input->GetWindowEvent(WE_HIDE)) return Idle();
+
+	profiler->BeginFrame();
+
 	PrepareUpdate();
 
 	if(input->GetWindowEvent(WE_QUIT)) return false;
+	if(exitRequested) return false;
+	if(maxFrames > 0 && frames > maxFrames) return false;
 	if(!PreUpdate()) return false;
 	if(!DoUpdate()) return false;
 	if(!PostUpdate()) return false;
 
 	FinishUpdate();
 
+	profiler->EndFrame();
+
 	return true;
 }
 
@@ -131,6 +190,41 @@ bool App::LoadConfig()
 // ---------------------------------------------
 void App::PrepareUpdate()
 {
+	frames++;
+
+	// Headless runs as fast as the CPU allows: every loop iteration is exactly one fixed step
+	if(headless)
+	{
+		dt = FIXED_TIMESTEP;
+		simulationSteps = 1;
+		simulationAlpha = 0.0f;
+		return;
+	}
+
+	if(idle) ResetClock();
+
+	uint64 currentCounter = SDL_GetPerformanceCounter();
+	if(lastFrameCounter == 0) lastFrameCounter = currentCounter;
+
+	dt = (float)((double)(currentCounter - lastFrameCounter) / (double)SDL_GetPerformanceFrequency());
+	lastFrameCounter = currentCounter;
+
+	// A breakpoint or a window drag can stall a frame for seconds, don't try to simulate all of it
+	if(dt > MAX_FRAME_TIME) dt = MAX_FRAME_TIME;
+
+	accumulator += dt;
+	simulationSteps = 0;
+
+	while(accumulator >= FIXED_TIMESTEP && simulationSteps < MAX_SIMULATION_STEPS)
+	{
+		accumulator -= FIXED_TIMESTEP;
+		simulationSteps++;
+	}
+
+	// If we hit the cap, drop the time we couldn't catch up with instead of carrying it over (spiral of death)
+	if(accumulator >= FIXED_TIMESTEP) accumulator = fmod(accumulator, (double)FIXED_TIMESTEP);
+
+	simulationAlpha = (float)(accumulator / FIXED_TIMESTEP);
 }
 
 // ---------------------------------------------
@@ -138,6 +232,18 @@ void App::FinishUpdate()
 {
 	if (loadGameRequested) LoadFromFile();
 	if (saveGameRequested) SaveToFile();
+
+	if(autosaveInterval > 0.0f && !headless)
+	{
+		autosaveTimer += dt;
+		if(autosaveTimer >= autosaveInterval)
+		{
+			autosaveTimer = 0.0f;
+			SaveToFile(AUTOSAVE_FILENAME);
+		}
+	}
+
+	saveWriter->DispatchCompleted();
 }
 
 // Call modules before each loop iteration
@@ -147,6 +253,7 @@ bool App::PreUpdate()
 	{
 		Module* pModule = item->data;
 		if(!pModule->active) continue;
+		PROFILE_SCOPE(profiler, pModule->name.GetString(), "PreUpdate");
 		if(!pModule->PreUpdate()) return false;
 	}
 	return true;
@@ -159,6 +266,7 @@ bool App::DoUpdate()
 	{
 		Module* pModule = item->data;
 		if(!pModule->active) continue;
+		PROFILE_SCOPE(profiler, pModule->name.GetString(), "Update");
 		if(!pModule->Update(dt)) return false;
 	}
 	return true;
@@ -171,19 +279,34 @@ bool App::PostUpdate()
 	{
 		Module* pModule = item->data;
 		if(!pModule->active) continue;
+		PROFILE_SCOPE(profiler, pModule->name.GetString(), "PostUpdate");
 		if(!pModule->PostUpdate()) return false;
 	}
 
-	if(input->GetKey(SDL_SCANCODE_P) == KEY_DOWN)
-	{
-		return PauseGame();
-	}
+	if(input->GetKey(SDL_SCANCODE_F9) == KEY_DOWN) profiler->DumpTrace(tracePath.c_str(), traceFrames > 0 ? traceFrames : PROFILER_FRAMES);
+
+	if(input->GetKey(SDL_SCANCODE_P) == KEY_DOWN && !headless) SetPaused(true);
+
 	return true;
 }
 
 // Called before quitting
 bool App::CleanUp()
 {
+	if(headless)
+	{
+		StoreRunResult();
+		if(!quiet) LogRunReport();
+	}
+
+	saveWriter->Flush();
+	saveWriter->DispatchCompleted();
+
+	// Zone counters that didn't fill a whole second yet (load times)
+	PERF_FLUSH();
+
+	if(traceOnExit) profiler->DumpTrace(tracePath.c_str(), traceFrames > 0 ? traceFrames : PROFILER_FRAMES);
+
 	ListItem<Module*>* item = modules.end;
 
 	while (item)
@@ -242,74 +365,289 @@ void App::SaveGameRequest()
 
 bool App::LoadFromFile()
 {
-	bool ret = true;
+	loadGameRequested = false;
+
+	// A save still on its way to disk would be read half old
+	saveWriter->Flush();
 
 	pugi::xml_document gameStateFile;
-	pugi::xml_parse_result result = gameStateFile.load_file("save_game.xml");
+	pugi::xml_parse_result result = gameStateFile.load_file(SAVE_STATE_FILENAME);
 
 	if (result == NULL)
 	{
-		LOG("Could not load xml file savegame.xml. pugi error: %s", result.description());
+		LOG("Could not load xml file %s. pugi error: %s", SAVE_STATE_FILENAME, result.description());
 		return false;
 	}
 	
-	ListItem<Module*>* item = modules.start;
+	pugi::xml_node loadStateOnFile = gameStateFile.child("save_state");
 
-	while (item && ret)
+	for(ListItem<Module*>* item = modules.start; item; item = item->next)
 	{
-		const char* itemName = item->data->name.GetString();
-		pugi::xml_node loadStateOnFile = gameStateFile.child("save_state");
-
-		if(!item->data->LoadState(loadStateOnFile.child(itemName))) return false;
-		item = item->next;
+		pugi::xml_node moduleNode = loadStateOnFile.child(item->data->name.GetString());
+		if(!item->data->LoadState(moduleNode)) return false;
 	}
 
+	// Play state, saves older than the snapshot format don't have it
+	FILE *file = nullptr;
+	if(fopen_s(&file, SAVE_SNAPSHOT_FILENAME, "rb") != 0 || !file) return true;
 
-	loadGameRequested = false;
+	std::vector<char> bytes;
+	fseek(file, 0, SEEK_END);
+	bytes.resize(ftell(file));
+	fseek(file, 0, SEEK_SET);
+	bool read = fread(bytes.data(), 1, bytes.size(), file) == bytes.size();
+	fclose(file);
+
+	PerfTimer timer;
+	if(!read || !RestoreSnapshot(bytes.data(), bytes.size()))
+	{
+		LOG("Could not restore %s", SAVE_SNAPSHOT_FILENAME);
+		return false;
+	}
+	LOG("Restored %u byte snapshot in %.3f ms", (uint)bytes.size(), timer.ReadMs());
 
 	return true;
 }
 
-bool App::SaveToFile() 
+bool App::SaveToFile(const char *path)
 {
-	auto* saveDoc = new pugi::xml_document();
+	saveGameRequested = false;
+
+	PerfTimer timer;
+
+	auto saveDoc = std::make_unique<pugi::xml_document>();
 	pugi::xml_node saveStateNode = saveDoc->append_child("save_state");
 
-	ListItem<Module*>* item = modules.start;
+	for(ListItem<Module*>* item = modules.start; item; item = item->next)
+	{
+		pugi::xml_node moduleNode = saveStateNode.append_child(item->data->name.GetString());
+		if(!item->data->SaveState(moduleNode)) return false;
+	}
 
+	// Only the manual save slot gets the binary play state next to it
+	SnapshotWriter snapshot;
+	if(strcmp(path, SAVE_STATE_FILENAME) == 0) CaptureSnapshot(snapshot);
 
-	while (item)
+	double snapshotMs = timer.ReadMs();
+
+	auto onSaved = [snapshotMs](SaveResult const &result) {
+		if(result.success) LOG("Saved %s: snapshot %.3f ms on the main thread, written in %.3f ms", result.path.c_str(), snapshotMs, result.writeMs);
+		else LOG("Saving %s failed", result.path.c_str());
+	};
+
+	saveWriter->Submit(std::move(saveDoc), path, onSaved);
+	if(snapshot.Size() > 0) saveWriter->Submit(std::move(snapshot.GetBuffer()), SAVE_SNAPSHOT_FILENAME, onSaved);
+
+	return true;
+}
+
+void App::CaptureSnapshot(SnapshotWriter &snapshot) const
+{
+	// Bodies are read directly, keep the physics thread off them meanwhile
+	auto worldGuard = physics->LockWorld();
+
+	snapshot.Reserve(4096);
+	size_t headerOffset = snapshot.Skip(sizeof(SnapshotHeader));
+	SnapshotHeader header;
+
+	for(ListItem<Module*>* item = modules.start; item; item = item->next)
 	{
-		const char *itemName = item->data->name.GetString();
+		char sectionName[SHORT_STR] = {};
+		strncpy_s(sectionName, SHORT_STR, item->data->name.GetString(), _TRUNCATE);
+		snapshot.Write(sectionName);
 
-		if(!item->data->SaveState(saveStateNode.append_child(itemName))) return false;
-		item = item->next;
+		size_t sizeOffset = snapshot.Skip(sizeof(uint32));
+		size_t sectionStart = snapshot.Size();
+		item->data->SaveSnapshot(snapshot);
+		snapshot.WriteAt(sizeOffset, (uint32)(snapshot.Size() - sectionStart));
+
+		header.sections++;
 	}
 
-	if(!saveDoc->save_file("save_game.xml")) return false;
+	header.payloadSize = (uint32)(snapshot.Size() - headerOffset - sizeof(SnapshotHeader));
+	snapshot.WriteAt(headerOffset, header);
+}
 
-	saveGameRequested = false;
+bool App::RestoreSnapshot(const char *data, size_t size)
+{
+	auto worldGuard = physics->LockWorld();
+
+	SnapshotReader snapshot(data, size);
+	SnapshotHeader header;
+
+	if(!snapshot.Read(header) || header.magic != SNAPSHOT_MAGIC || header.version != SNAPSHOT_VERSION)
+	{
+		LOG("Not a snapshot, or from another version (expected version %u)", SNAPSHOT_VERSION);
+		return false;
+	}
+
+	// A section failing halfway would leave the table half loaded
+	if(!CheckSnapshot(snapshot, header)) return false;
+
+	for(uint32 i = 0; i < header.sections; i++)
+	{
+		char sectionName[SHORT_STR];
+		uint32 sectionSize = 0;
+		if(!snapshot.Read(sectionName) || !snapshot.Read(sectionSize)) return false;
+		sectionName[SHORT_STR - 1] = '\0';
+
+		// Modules missing from this table (headless has no renderer) just skip their section
+		Module *module = FindModule(sectionName);
+
+		size_t sectionStart = snapshot.GetOffset();
+		if(!module)
+		{
+			if(!snapshot.Skip(sectionSize)) return false;
+			continue;
+		}
+
+		if(!module->LoadSnapshot(snapshot) || snapshot.GetOffset() != sectionStart + sectionSize)
+		{
+			LOG("Snapshot section %s does not match this table", sectionName);
+			return false;
+		}
+	}
+
+	return !snapshot.Failed();
+}
+
+bool App::CheckSnapshot(SnapshotReader snapshot, SnapshotHeader const &header) const
+{
+	size_t payloadStart = snapshot.GetOffset();
+
+	for(uint32 i = 0; i < header.sections; i++)
+	{
+		char sectionName[SHORT_STR];
+		uint32 sectionSize = 0;
+		SnapshotReader section(nullptr, 0);
+		if(!snapshot.Read(sectionName) || !snapshot.Read(sectionSize) || !snapshot.Split(sectionSize, section))
+		{
+			LOG("Snapshot is cut short");
+			return false;
+		}
+		sectionName[SHORT_STR - 1] = '\0';
+
+		Module *module = FindModule(sectionName);
+		if(!module) continue;
+
+		// Sections only hold fixed size state, the same table layout writes the same size
+		SnapshotWriter expected;
+		module->SaveSnapshot(expected);
+
+		if(sectionSize != expected.Size() || !module->CheckSnapshot(section))
+		{
+			LOG("Snapshot section %s does not match this table", sectionName);
+			return false;
+		}
+	}
+
+	if(snapshot.GetOffset() - payloadStart != header.payloadSize)
+	{
+		LOG("Snapshot payload is %u bytes, its header says %u", (uint)(snapshot.GetOffset() - payloadStart), header.payloadSize);
+		return false;
+	}
 
 	return true;
 }
 
-bool App::PauseGame() const
+Module *App::FindModule(const char *name) const
 {
-	physics->ToggleStep();
-	while(input->GetKey(SDL_SCANCODE_P) == KEY_DOWN || input->GetKey(SDL_SCANCODE_P) == KEY_REPEAT)
+	for(ListItem<Module*>* item = modules.start; item; item = item->next)
 	{
-		input->PreUpdate();
-		if(app->input->GetKey(SDL_SCANCODE_ESCAPE) == KEY_DOWN) return false;
+		if(strcmp(item->data->name.GetString(), name) == 0) return item->data;
 	}
-	while(input->GetKey(SDL_SCANCODE_P) == KEY_IDLE || input->GetKey(SDL_SCANCODE_P) == KEY_UP)
+	return nullptr;
+}
+
+void App::SetPaused(bool pause)
+{
+	paused = pause;
+	LOG(paused ? "Game paused" : "Game resumed");
+}
+
+bool App::IsPaused() const
+{
+	return paused;
+}
+
+bool App::Idle()
+{
+	idle = true;
+
+	// Blocks inside SDL instead of spinning, wakes up on any event
+	input->WaitForEvents(IDLE_WAIT_MS);
+
+	if(input->GetWindowEvent(WE_QUIT)) return false;
+
+	if(paused)
 	{
-		input->PreUpdate();
-		if(app->input->GetKey(SDL_SCANCODE_ESCAPE) == KEY_DOWN) return false;
+		if(input->GetKey(SDL_SCANCODE_ESCAPE) == KEY_DOWN) return false;
+		if(input->GetKey(SDL_SCANCODE_P) == KEY_DOWN) SetPaused(false);
 	}
-	physics->ToggleStep();
+
 	return true;
 }
 
+void App::ResetClock()
+{
+	lastFrameCounter = 0;
+	accumulator = 0.0;
+	idle = false;
+}
+
+bool App::IsHeadless() const
+{
+	return headless;
+}
+
+void App::RequestExit()
+{
+	exitRequested = true;
+}
+
+TableResult App::GetRunResult() const
+{
+	return runResult;
+}
+
+void App::StoreRunResult()
+{
+	BallStats ballStats = entityManager->GetBallStats();
+
+	runResult.frames = (frames > 0) ? frames - 1 : 0;
+	runResult.score = entityManager->GetScore();
+	runResult.ballsLost = ballStats.ballsLost;
+	runResult.sensorHits = ballStats.sensorHits;
+	if(ballStats.ballsLost > 0) runResult.averageBallLifetime = (float)ballStats.lifetimeSteps * FIXED_TIMESTEP / (float)ballStats.ballsLost;
+	runResult.seconds = (double)(SDL_GetPerformanceCounter() - runStartCounter) / (double)SDL_GetPerformanceFrequency();
+}
+
+void App::LogRunReport() const
+{
+	double framesPerSecond = (runResult.seconds > 0.0) ? (double)runResult.frames / runResult.seconds : 0.0;
+
+	LOG("Headless run: %u frames in %.3f s (%.0f simulated frames/s), final score %u", runResult.frames, runResult.seconds, framesPerSecond, runResult.score);
+
+	// Build boxes read stdout, not the debugger output
+	printf("Headless run: %u frames in %.3f s (%.0f simulated frames/s)\n", runResult.frames, runResult.seconds, framesPerSecond);
+	printf("Final score: %u\n", runResult.score);
+}
+
+float App::GetFixedDeltaTime() const
+{
+	return FIXED_TIMESTEP;
+}
+
+uint App::GetSimulationSteps() const
+{
+	return simulationSteps;
+}
+
+float App::GetSimulationAlpha() const
+{
+	return simulationAlpha;
+}
+
 bool App::SaveToConfig(std::string const &moduleName, std::string const &node, std::string const &attribute, std::string const &value) const
 {
 	if(configNode.child(moduleName.c_str()).child(node.c_str()).attribute(attribute.c_str()))
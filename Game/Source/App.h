@@ -8,6 +8,25 @@
 
 #define CONFIG_FILENAME		"config.xml"
 #define SAVE_STATE_FILENAME "save_game.xml"
+#define AUTOSAVE_FILENAME	"autosave_game.xml"
+#define SAVE_SNAPSHOT_FILENAME "save_game.bin"
+
+// Simulation clock
+#define FIXED_TIMESTEP			(1.0f / 60.0f)
+#define MAX_SIMULATION_STEPS	5
+#define MAX_FRAME_TIME			0.25f
+#define IDLE_WAIT_MS			250		// Longest sleep on the event queue while paused or hidden
+
+// Outcome of a headless game
+struct TableResult
+{
+	uint frames = 0;
+	uint score = 0;
+	uint ballsLost = 0;
+	float averageBallLifetime = 0.0f;	// seconds of simulation
+	uint sensorHits = 0;
+	double seconds = 0.0;				// wall clock
+};
 
 // Modules
 class Window;
@@ -20,6 +39,11 @@ class EntityManager;
 class Map;
 class Fonts;
 class Physics;
+class Profiler;
+class SaveWriter;
+class SnapshotWriter;
+class SnapshotReader;
+struct SnapshotHeader;
 
 class App
 {
@@ -56,9 +80,27 @@ public:
 	void LoadGameRequest();
 	void SaveGameRequest() ;
 	bool LoadFromFile();
-	bool SaveToFile();
 
-	bool PauseGame() const;
+	// Fills a save document and hands it to the writer thread, the file is written in the background
+	bool SaveToFile(const char *path = SAVE_STATE_FILENAME);
+
+	// Binary state of every module (bodies, joints, ball, animations), one section per module
+	void CaptureSnapshot(SnapshotWriter &snapshot) const;
+	bool RestoreSnapshot(const char *data, size_t size);
+
+	// Paused: nothing is simulated or drawn until P is pressed again
+	void SetPaused(bool pause);
+	bool IsPaused() const;
+
+	// Headless simulation
+	bool IsHeadless() const;
+	void RequestExit();
+	TableResult GetRunResult() const;
+
+	// Simulation clock
+	float GetFixedDeltaTime() const;
+	uint GetSimulationSteps() const;
+	float GetSimulationAlpha() const;
 
 	bool SaveToConfig(std::string const &moduleName, std::string const &node, std::string const &attribute, std::string const &value) const;
 
@@ -67,6 +109,24 @@ private:
 	// Load config file
 	bool LoadConfig();
 
+	// Module with that name, nullptr when this table doesn't have it
+	Module *FindModule(const char *name) const;
+
+	// Every section of the snapshot fits this table, checked before anything is loaded
+	bool CheckSnapshot(SnapshotReader snapshot, SnapshotHeader const &header) const;
+
+	// Gather the results of a headless run while the entities are still alive
+	void StoreRunResult();
+
+	// Print frames per second and score of a headless run
+	void LogRunReport() const;
+
+	// Paused or hidden window: sleep until an event arrives
+	bool Idle();
+
+	// Forget the time spent idle so there's no catch-up when frames resume
+	void ResetClock();
+
 	// Call modules before each loop iteration
 	void PrepareUpdate();
 
@@ -96,6 +156,9 @@ public:
 	Physics* physics;
 	Fonts *fonts;
 
+	// Frame zones of the main loop, dumped as a Chrome trace
+	Profiler *profiler;
+
 private:
 
 	int argc;
@@ -111,12 +174,36 @@ private:
 	uint frames;
 	float dt;
 
-    bool saveGameRequested;
-	bool loadGameRequested;
+	// Headless simulation
+	bool headless = false;
+	bool exitRequested = false;
+	bool quiet = false;
+	uint maxFrames = 0;
+	uint64 runStartCounter = 0;
+	TableResult runResult;
+
+	// Chrome trace written on F9 and, if set from the command line, on exit
+	std::string tracePath = "trace.json";
+	bool traceOnExit = false;
+	uint traceFrames = 0;
+
+	// Fixed timestep accumulator
+	uint64 lastFrameCounter = 0;
+	double accumulator = 0.0;
+	uint simulationSteps = 0;
+	float simulationAlpha = 0.0f;
+	bool paused = false;
+	bool idle = false;
+
+	bool saveGameRequested = false;
+	bool loadGameRequested = false;
+
+	// Saves are written on their own thread
+	SaveWriter *saveWriter = nullptr;
+	float autosaveInterval = 0.0f;
+	float autosaveTimer = 0.0f;
 
 	uint levelNumber = 1;
 };
 
-extern App* app;
-
 #endif	// __APP_H__
\ No newline at end of file
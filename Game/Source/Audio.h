@@ -12,7 +12,7 @@ class Audio : public Module
 {
 public:
 
-	Audio();
+	explicit Audio(App* app);
 
 	// Destructor
 	virtual ~Audio();
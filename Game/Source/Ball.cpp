@@ -8,12 +8,28 @@
 #include "Log.h"
 #include "Point.h"
 #include "Physics.h"
+#include "Snapshot.h"
+#include "EntityManager.h"
 
-constexpr uint BALL_SIZE = 30;
+Ball::Ball(App* app) : Entity(app, EntityType::UNKNOWN) {}
 
-Ball::Ball() : Entity(EntityType::UNKNOWN) {}
+Ball::Ball(App* app, pugi::xml_node const &itemNode = pugi::xml_node()) : Entity(app, itemNode) {}
 
-Ball::Ball(pugi::xml_node const &itemNode = pugi::xml_node()) : Entity(itemNode) {}
+Ball::Ball(App* app, pugi::xml_node const &itemNode, PhysBody *body, SDL_Texture *image) : Entity(app, EntityType::BALL), extra(true)
+{
+	// Hundreds may come in one frame: skip the name regex, and free the Animation the texture starts with
+	// before the image takes its place
+	name = itemNode.name();
+	parameters = itemNode;
+
+	texture.anim.reset();
+	texture.type = RenderModes::IMAGE;
+	texture.image = image;
+
+	pBody = body;
+	pBody->listener = this;
+	pBody->ctype = ColliderType::BALL;
+}
 
 Ball::~Ball() = default;
 
@@ -21,8 +37,8 @@ bool Ball::Awake()
 {
 	position.x = parameters.attribute("x").as_int();
 	position.y = parameters.attribute("y").as_int();
-	scoreList.first = parameters.attribute("highscore").as_uint();
-	scoreList.second = 0;
+	GetTable().scoreList.first = parameters.attribute("highscore").as_uint();
+	GetTable().scoreList.second = 0;
 	SetPaths();
 
 	return true;
@@ -35,7 +51,7 @@ bool Ball::Start() {
 
 	std::string ballImage = texLevelPath + name + ".png";
 
-	texture.image = app->tex->Load(ballImage.c_str());
+	if(app->tex) texture.image = app->tex->Load(ballImage.c_str());
 
 	CreatePhysBody();
 
@@ -44,51 +60,66 @@ bool Ball::Start() {
 
 bool Ball::Update()
 {
-	if(timeUntilReset > 120)
+	// Game timers run on simulation steps so they don't depend on the render rate
+	uint steps = app->GetSimulationSteps();
+
+	// The table's own ball waits for the other balls to drain, drained multiball ones are removed by the EntityManager
+	if(timeUntilReset > 120 && !extra && app->entityManager->GetBallsInPlay() == 0)
 	{
+		TableScore &table = GetTable();
+
 		SetStartingPosition();
 		timeUntilReset = -1;
-		if(hp <= 0)
+		if(table.hp <= 0)
 		{
-			if((uint)score > scoreList.first)
+			if((uint)table.score > table.scoreList.first)
 			{
-				scoreList.first = (uint)score;
-				app->SaveToConfig("scene", "ball", "highscore", std::to_string(scoreList.first));
+				table.scoreList.first = (uint)table.score;
+				if(!app->IsHeadless()) app->SaveToConfig("scene", "ball", "highscore", std::to_string(table.scoreList.first));
 			}
-			scoreList.second = (uint)score;
-			ResetScore();
-			hp = 3;
+			table.scoreList.second = (uint)table.score;
+
+			// A headless run simulates a single game
+			if(app->IsHeadless())
+			{
+				app->RequestExit();
+				return true;
+			}
+
+			table.score = 0;
+			table.hp = 3;
 		}
 	}
 	else if(timeUntilReset >= 0)
 	{
-		timeUntilReset++;
+		timeUntilReset += steps;
 	}
 	else
 	{
-		score += 0.002f * (float)scoreMultiplier;
+		currentLifetimeSteps += steps;
 	}
 
-	//Update ball position in pixels
-	position.x = METERS_TO_PIXELS(pBody->body->GetTransform().p.x) - BALL_SIZE/2;
-	position.y = METERS_TO_PIXELS(pBody->body->GetTransform().p.y) - BALL_SIZE/2;
+	//Update ball position in pixels, interpolated between the last two physics steps
+	b2Vec2 renderPosition = pBody->GetInterpolatedPosition(app->GetSimulationAlpha());
+	position.x = METERS_TO_PIXELS(renderPosition.x) - BALL_SIZE/2;
+	position.y = METERS_TO_PIXELS(renderPosition.y) - BALL_SIZE/2;
 
-	app->render->DrawTexture(texture.image, position.x , position.y);
+	if(!app->render) return true;
 
-	for(int i = 0; i < hp; i++)
-	{
-		app->render->DrawTexture(texture.image, 710, 930 - i*(BALL_SIZE + 10));
-	}
+	app->render->DrawTexture(texture.image, position.x , position.y);
 
 	return true;
 }
 
 bool Ball::CleanUp()
 {
+	// The texture belongs to the table's own ball
+	if(extra) return true;
+
 	switch(texture.type)
 	{
 		case RenderModes::IMAGE:
-			app->tex->UnLoad(texture.image);
+			if(app->tex) app->tex->UnLoad(texture.image);
 			break;
 		case RenderModes::ANIMATION:
 			texture.anim->CleanUp();
@@ -102,13 +133,14 @@ bool Ball::CleanUp()
 
 void Ball::OnCollision(PhysBody* physA, PhysBody* physB) {
 	if(timeUntilReset >= 0) return;
+	TableScore &table = GetTable();
 	switch (physB->ctype)
 	{
 		case ColliderType::ITEM:
-			if(score < 99999)
+			if(table.score < 99999)
 			{
-				score += (float)(100 * scoreMultiplier);
-				if(score > 99999) score = 99999;
+				table.score += (float)(100 * table.scoreMultiplier);
+				if(table.score > 99999) table.score = 99999;
 			}
 			LOG("Collision ITEM");
 			break;
@@ -117,11 +149,21 @@ void Ball::OnCollision(PhysBody* physA, PhysBody* physB) {
 			break;
 		case ColliderType::SENSOR:
 			LOG("Collision SENSOR");
+			table.stats.sensorHits++;
 			switch(physB->sensorFunction)
 			{
 				case SensorFunction::DEATH:
 					timeUntilReset = 0;
-					hp--;
+					table.stats.ballsLost++;
+					table.stats.lifetimeSteps += currentLifetimeSteps;
+					currentLifetimeSteps = 0;
+
+					// Only the last ball in play costs a life
+					if(app->entityManager->GetBallsInPlay() > 0 || table.hp == 0) break;
+					table.hp--;
+
+					// Show how it got there while the ball waits to be reset
+					if(float seconds = app->physics->GetDrainReplaySeconds()) app->physics->Replay(seconds);
 					break;
 
 				case SensorFunction::POWER:
@@ -148,35 +190,54 @@ void Ball::OnCollision(PhysBody* physA, PhysBody* physB) {
 	}
 }
 
-void Ball::ResetScore()
+int Ball::GetTimeUntilReset() const
 {
-	score = 0;
+	return timeUntilReset;
 }
 
-uint Ball::GetScore() const
+bool Ball::IsInPlay() const
 {
-	return score;
+	return timeUntilReset < 0;
 }
 
-void Ball::AddMultiplier(uint n)
+bool Ball::IsGone() const
 {
-	scoreMultiplier += n;
+	return extra && timeUntilReset > 120;
 }
 
-int Ball::GetTimeUntilReset() const
+BodyDesc Ball::DescribeBall(int x, int y) const
 {
-	return timeUntilReset;
+	// A bullet circle, so it can't tunnel through thin colliders. It only collides with the board and sensor layers, so balls pass through each other
+	return Physics::CircleDesc(x, y, BALL_SIZE/2, BodyType::DYNAMIC, 0.7f, (uint16)Layers::BALL, (uint16)Layers::BOARD | (uint16)Layers::SENSOR, true);
 }
 
-std::pair<uint, uint> Ball::GetScoreList() const
+void Ball::SaveSnapshot(SnapshotWriter &snapshot) const
 {
-	return scoreList;
+	Entity::SaveSnapshot(snapshot);
+
+	snapshot.Write(timeUntilReset);
+	snapshot.Write(currentLifetimeSteps);
+}
+
+bool Ball::LoadSnapshot(SnapshotReader &snapshot)
+{
+	if(!Entity::LoadSnapshot(snapshot)) return false;
+
+	snapshot.Read(timeUntilReset);
+	snapshot.Read(currentLifetimeSteps);
+
+	return !snapshot.Failed();
+}
+
+TableScore &Ball::GetTable() const
+{
+	return app->entityManager->table;
 }
 
 void Ball::CreatePhysBody()
 {
 	//initialize physics body
-	pBody = app->physics->CreateCircle(position.x+BALL_SIZE/2, position.y+BALL_SIZE/2, BALL_SIZE/2, BodyType::DYNAMIC, 0.7f, (uint16)Layers::BALL, (uint16)Layers::BOARD | (uint16)Layers::SENSOR);
+	pBody = app->physics->CreateBody(DescribeBall(position.x+BALL_SIZE/2, position.y+BALL_SIZE/2));
 
 	//This makes the Physics module to call the OnCollision method
 	pBody->listener = this;
@@ -187,8 +248,9 @@ void Ball::CreatePhysBody()
 
 void Ball::SetStartingPosition()
 {
-	if(pBody->body) app->physics->DestroyBody(pBody->body);
 	position.x = parameters.attribute("x").as_int();
 	position.y = parameters.attribute("y").as_int();
-	CreatePhysBody();
+
+	// Same body and pool slot every life, only moved back to the start
+	app->physics->ResetBody(pBody, position.x+BALL_SIZE/2, position.y+BALL_SIZE/2);
 }
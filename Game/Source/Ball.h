@@ -7,15 +7,22 @@
 #include <array>
 
 struct SDL_Texture;
+struct BodyDesc;
+struct TableScore;
+
+constexpr uint BALL_SIZE = 30;
 
 class Ball : public Entity
 {
 public:
 
-	explicit Ball();
+	explicit Ball(App* app);
+
+	explicit Ball(App* app, const pugi::xml_node &itemNode);
+
+	// A multiball ball: body made by the spawner, drawn with the table ball's texture, gone once it drains
+	explicit Ball(App* app, const pugi::xml_node &itemNode, PhysBody *body, SDL_Texture *image);
 
-	explicit Ball(const pugi::xml_node &itemNode);
-	
 	~Ball() final;
 
 	bool Awake() final;
@@ -28,30 +35,32 @@ public:
 
 	void OnCollision(PhysBody* physA, PhysBody* physB) final;
 
-	void ResetScore();
+	int GetTimeUntilReset() const;
 
-	uint GetScore() const final;
+	// Not drained or waiting to be reset
+	bool IsInPlay() const;
 
-	void AddMultiplier(uint n) final;
+	// A multiball ball that drained and can be removed
+	bool IsGone() const;
 
-	int GetTimeUntilReset() const;
+	// The one shape every ball of the table is made from, at x,y (pixels)
+	BodyDesc DescribeBall(int x, int y) const;
 
-	std::pair<uint, uint> GetScoreList() const final;
+	void SaveSnapshot(SnapshotWriter &snapshot) const final;
+	bool LoadSnapshot(SnapshotReader &snapshot) final;
 
 private:
 
 	void CreatePhysBody();
 	void SetStartingPosition();
 
-	float score = 0;
-	uint scoreMultiplier = 1;
-	std::pair<uint, uint> scoreList;
-
-	uint hp = 3;
+	TableScore &GetTable() const;
 
-	SDL_Texture *hpTexture = nullptr;
+	bool extra = false;
 
 	int timeUntilReset = -1;
+
+	uint currentLifetimeSteps = 0;
 };
 
-#endif // __BALL_H__
\ No newline at end of file
+#endif // __BALL_H__
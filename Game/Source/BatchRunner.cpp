@@ -0,0 +1,162 @@
+#include "BatchRunner.h"
+#include "JobSystem.h"
+
+#include "Defs.h"
+#include "Log.h"
+
+#include "Box2D/Box2D/Box2D.h"
+#include "SDL/include/SDL.h"
+
+#include <algorithm>
+#include <climits>
+#include <memory>
+
+BatchRunner::BatchRunner(int argc, char* args[])
+{
+	for(int i = 1; i < argc; i++)
+	{
+		bool hasValue = (i + 1 < argc);
+
+		if(strcmp(args[i], "--batch") == 0 && hasValue) tableCount = atoi(args[++i]);
+		else if(strcmp(args[i], "--script") == 0 && hasValue) scripts.emplace_back(args[++i]);
+		else if(strcmp(args[i], "--frames") == 0 && hasValue) maxFrames = atoi(args[++i]);
+		else if(strcmp(args[i], "--threads") == 0 && hasValue) threadCount = atoi(args[++i]);
+		else if(strcmp(args[i], "--stagger") == 0 && hasValue) staggerFrames = atoi(args[++i]);
+	}
+}
+
+bool BatchRunner::IsRequested(int argc, char* args[])
+{
+	for(int i = 1; i < argc; i++)
+	{
+		if(strcmp(args[i], "--batch") == 0) return true;
+	}
+	return false;
+}
+
+int BatchRunner::Run()
+{
+	if(tableCount == 0 || scripts.empty())
+	{
+		printf("Batch run needs --batch <tables> and at least one --script <file>\n");
+		return EXIT_FAILURE;
+	}
+
+	results.assign(tableCount, TableResult());
+	completed.assign(tableCount, 0);
+
+	// Box2D fills its block size table the first time an allocator is built, and its
+	// contact type table on the first contact. Step a throwaway world with two
+	// overlapping fixtures so the tables don't all race to write them.
+	// b2_gjkCalls and b2_toiCalls stay shared; they are debug counters nobody reads
+	{
+		b2World warmUp(b2Vec2(0.0f, 0.0f));
+
+		b2CircleShape circle;
+		circle.m_radius = 1.0f;
+
+		b2BodyDef def;
+		def.type = b2_dynamicBody;
+		warmUp.CreateBody(&def)->CreateFixture(&circle, 1.0f);
+		warmUp.CreateBody(&def)->CreateFixture(&circle, 1.0f);
+
+		warmUp.Step(1.0f / 60.0f, 1, 1);
+	}
+
+	JobSystem jobs(threadCount);
+
+	for(uint i = 0; i < tableCount; i++)
+	{
+		jobs.Submit([this, i]() { RunTable(i); });
+	}
+
+	uint64 startCounter = SDL_GetPerformanceCounter();
+	jobs.Run();
+	double wallSeconds = (double)(SDL_GetPerformanceCounter() - startCounter) / (double)SDL_GetPerformanceFrequency();
+
+	PrintResults(wallSeconds, jobs.GetWorkerCount(), jobs.GetStolenCount());
+
+	bool allCompleted = std::all_of(completed.begin(), completed.end(), [](char c) { return c != 0; });
+	return allCompleted ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+void BatchRunner::RunTable(uint index)
+{
+	// Scripts are dealt round robin, stagger shifts each table's script so identical scripts still play different games
+	std::vector<std::string> tableArgs = {
+		"Game",
+		"--headless",
+		"--quiet",
+		"--frames", std::to_string(maxFrames),
+		"--script", scripts[index % scripts.size()],
+		"--script-offset", std::to_string(index * staggerFrames)
+	};
+
+	std::vector<char*> argv;
+	for(auto &arg : tableArgs)
+	{
+		argv.push_back(&arg[0]);
+	}
+	argv.push_back(nullptr);
+
+	auto table = std::make_unique<App>((int)tableArgs.size(), argv.data());
+
+	if(!table->Awake() || !table->Start())
+	{
+		LOG("Batch table %u failed to start", index);
+		return;
+	}
+
+	while(table->Update());
+
+	if(!table->CleanUp())
+	{
+		LOG("Batch table %u failed to clean up", index);
+		return;
+	}
+
+	results[index] = table->GetRunResult();
+	completed[index] = 1;
+}
+
+void BatchRunner::PrintResults(double wallSeconds, uint workers, uint stolen) const
+{
+	printf("%6s %8s %8s %6s %10s %8s %8s\n", "table", "frames", "score", "lost", "lifetime s", "sensors", "wall s");
+
+	uint played = 0;
+	uint64 totalFrames = 0;
+	double tableSeconds = 0.0;
+	double scoreSum = 0.0;
+	double lifetimeSum = 0.0;
+	double sensorSum = 0.0;
+	uint scoreMin = UINT_MAX;
+	uint scoreMax = 0;
+
+	for(uint i = 0; i < tableCount; i++)
+	{
+		if(!completed[i])
+		{
+			printf("%6u %8s\n", i, "failed");
+			continue;
+		}
+
+		TableResult const &result = results[i];
+		printf("%6u %8u %8u %6u %10.2f %8u %8.3f\n", i, result.frames, result.score, result.ballsLost, result.averageBallLifetime, result.sensorHits, result.seconds);
+
+		played++;
+		totalFrames += result.frames;
+		tableSeconds += result.seconds;
+		scoreSum += result.score;
+		lifetimeSum += result.averageBallLifetime;
+		sensorSum += result.sensorHits;
+		scoreMin = MIN(scoreMin, result.score);
+		scoreMax = MAX(scoreMax, result.score);
+	}
+
+	if(played == 0) return;
+
+	printf("\n%u/%u tables, %u workers, %u jobs stolen\n", played, tableCount, workers, stolen);
+	printf("Score: mean %.1f min %u max %u\n", scoreSum / played, scoreMin, scoreMax);
+	printf("Ball lifetime: mean %.2f s, sensor hits: mean %.1f\n", lifetimeSum / played, sensorSum / played);
+	printf("%llu frames in %.3f s wall (%.0f frames/s, %.1fx parallel speedup)\n", totalFrames, wallSeconds, (double)totalFrames / wallSeconds, tableSeconds / wallSeconds);
+}
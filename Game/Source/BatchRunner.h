@@ -0,0 +1,42 @@
+#ifndef __BATCHRUNNER_H__
+#define __BATCHRUNNER_H__
+
+#include "App.h"
+
+#include <string>
+#include <vector>
+
+// Plays N headless tables in parallel, each driven by an input script,
+// and prints the aggregated results.
+// Game --batch 64 --script Scripts/a.txt --script Scripts/b.txt [--frames 36000] [--threads 8] [--stagger 7]
+class BatchRunner
+{
+public:
+
+	BatchRunner(int argc, char* args[]);
+
+	// True if the command line asks for a batch run
+	static bool IsRequested(int argc, char* args[]);
+
+	// Returns the process exit code
+	int Run();
+
+private:
+
+	// Build, play and clean up a whole table on the calling thread
+	void RunTable(uint index);
+
+	void PrintResults(double wallSeconds, uint workers, uint stolen) const;
+
+	uint tableCount = 0;
+	uint threadCount = 0;
+	uint maxFrames = 36000;
+	uint staggerFrames = 0;
+	std::vector<std::string> scripts;
+
+	// One slot per table, each written only by the thread that played it
+	std::vector<TableResult> results;
+	std::vector<char> completed;
+};
+
+#endif // __BATCHRUNNER_H__
@@ -0,0 +1,238 @@
+#include "ColliderBlob.h"
+
+#include "Snapshot.h"
+#include "SaveWriter.h"
+#include "PerfTimer.h"
+#include "PointListParser.h"
+#include "Log.h"
+
+#include "PugiXml/src/pugixml.hpp"
+
+#include <mutex>
+#include <string.h>
+#include <sys/stat.h>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+	const std::unordered_map<std::string, ColliderShape> shapeStrToEnum{
+		{"chain", ColliderShape::CHAIN},
+		{"polygon", ColliderShape::POLYGON},
+		{"circle", ColliderShape::CIRCLE},
+		{"rectangle", ColliderShape::RECTANGLE},
+		{"rectangle_sensor", ColliderShape::RECTANGLE_SENSOR}
+	};
+
+	const std::unordered_map<std::string, Layers> layerStrToEnum{
+		{"launch", Layers::LAUNCH},
+		{"board", Layers::BOARD},
+		{"kickers", Layers::KICKERS},
+		{"ball", Layers::BALL},
+		{"top", Layers::TOP},
+		{"sensor", Layers::SENSOR}
+	};
+
+	// Every table of a batch loads the same file, only one of them cooks it
+	std::mutex cookLock;
+
+	std::mutex indexLock;
+	std::unordered_map<std::string, std::weak_ptr<ColliderBlob const>> indices;
+
+	bool GetSourceInfo(std::string const &path, uint64 &size, uint64 &time)
+	{
+#ifdef _WIN32
+		struct _stat64 info;
+		if(_stat64(path.c_str(), &info) != 0) return false;
+#else
+		struct stat info;
+		if(stat(path.c_str(), &info) != 0) return false;
+#endif
+		size = (uint64)info.st_size;
+		time = (uint64)info.st_mtime;
+		return true;
+	}
+}
+
+std::shared_ptr<ColliderBlob const> ColliderBlob::Acquire(std::string const &xmlPath)
+{
+	std::lock_guard<std::mutex> guard(indexLock);
+
+	std::weak_ptr<ColliderBlob const> &cached = indices[xmlPath];
+	if(auto index = cached.lock()) return index;
+
+	PerfTimer timer;
+	auto index = std::make_shared<ColliderBlob>();
+	if(!index->Load(xmlPath)) return nullptr;
+
+	size_t indexBytes = sizeof(ColliderBlob) + index->byName.size() * (sizeof(std::string) + sizeof(ColliderRecord const *) + 2 * sizeof(void *)) + index->byName.bucket_count() * sizeof(void *);
+	LOG("Collider index for %s: %u colliders from a %u byte mapping plus %u bytes of index, built in %.3f ms",
+		xmlPath.c_str(), index->GetColliderCount(), (uint)index->file.GetSize(), (uint)indexBytes, timer.ReadMs());
+
+	cached = index;
+	return index;
+}
+
+bool ColliderBlob::Load(std::string const &xmlPath)
+{
+	std::string blobPath = GetBlobPath(xmlPath);
+
+	uint64 sourceSize = 0;
+	uint64 sourceTime = 0;
+	bool hasSource = GetSourceInfo(xmlPath, sourceSize, sourceTime);
+
+	std::lock_guard<std::mutex> guard(cookLock);
+
+	// Without the xml, whatever blob shipped is the truth
+	if(Map(blobPath) && (!hasSource || (header->sourceSize == sourceSize && header->sourceTime == sourceTime))) return true;
+
+	file.Close();
+	header = nullptr;
+	if(!hasSource)
+	{
+		LOG("Neither %s nor a valid %s found", xmlPath.c_str(), blobPath.c_str());
+		return false;
+	}
+
+	PerfTimer timer;
+	if(!Cook(xmlPath, blobPath) || !Map(blobPath)) return false;
+	LOG("Cooked %s into %s: %u colliders, %u vertices in %.3f ms", xmlPath.c_str(), blobPath.c_str(), header->colliderCount, header->vertexCount, timer.ReadMs());
+
+	return true;
+}
+
+bool ColliderBlob::Map(std::string const &blobPath)
+{
+	if(!file.Open(blobPath.c_str()) || file.GetSize() < sizeof(ColliderBlobHeader)) return false;
+
+	header = (ColliderBlobHeader const *)file.GetData();
+	if(header->magic != COLLIDER_BLOB_MAGIC || header->version != COLLIDER_BLOB_VERSION || header->recordSize != sizeof(ColliderRecord))
+	{
+		LOG("%s is from another version, cooking it again", blobPath.c_str());
+		return false;
+	}
+
+	size_t expected = sizeof(ColliderBlobHeader) + header->colliderCount * sizeof(ColliderRecord) + header->vertexCount * sizeof(b2Vec2);
+	if(file.GetSize() != expected)
+	{
+		LOG("%s is truncated, cooking it again", blobPath.c_str());
+		return false;
+	}
+
+	records = (ColliderRecord const *)(file.GetData() + sizeof(ColliderBlobHeader));
+	vertices = (b2Vec2 const *)(records + header->colliderCount);
+
+	for(uint32 i = 0; i < header->colliderCount; i++)
+	{
+		if(records[i].firstVertex + records[i].vertexCount > header->vertexCount) return false;
+	}
+
+	BuildIndex();
+
+	return true;
+}
+
+void ColliderBlob::BuildIndex()
+{
+	byName.clear();
+	byName.reserve(header->colliderCount);
+
+	for(uint32 i = 0; i < header->colliderCount; i++)
+	{
+		// Cooked names may fill the whole field without a terminator
+		byName.emplace(std::string(records[i].name, strnlen(records[i].name, SHORT_STR)), &records[i]);
+	}
+}
+
+ColliderRecord const *ColliderBlob::Find(const char *name) const
+{
+	auto record = byName.find(name);
+	return record != byName.end() ? record->second : nullptr;
+}
+
+b2Vec2 const *ColliderBlob::GetVertices(ColliderRecord const &record) const
+{
+	return vertices + record.firstVertex;
+}
+
+uint32 ColliderBlob::GetColliderCount() const
+{
+	return header ? header->colliderCount : 0;
+}
+
+std::string ColliderBlob::GetBlobPath(std::string const &xmlPath)
+{
+	size_t extension = xmlPath.rfind(".xml");
+	return (extension == std::string::npos ? xmlPath : xmlPath.substr(0, extension)) + ".bin";
+}
+
+bool ColliderBlob::Cook(std::string const &xmlPath, std::string const &blobPath)
+{
+	pugi::xml_document collidersFile;
+	pugi::xml_parse_result parseResult = collidersFile.load_file(xmlPath.c_str());
+
+	if(!parseResult)
+	{
+		LOG("Error cooking %s: %s", xmlPath.c_str(), parseResult.description());
+		return false;
+	}
+
+	ColliderBlobHeader blobHeader;
+	blobHeader.recordSize = sizeof(ColliderRecord);
+	GetSourceInfo(xmlPath, blobHeader.sourceSize, blobHeader.sourceTime);
+
+	std::vector<ColliderRecord> colliders;
+	std::vector<b2Vec2> points;
+
+	for(pugi::xml_node const &colliderNode : collidersFile.child("collider_info").children())
+	{
+		ColliderRecord record;
+		strncpy_s(record.name, SHORT_STR, colliderNode.name(), _TRUNCATE);
+
+		std::string shape = colliderNode.attribute("shape").as_string();
+		if(shapeStrToEnum.count(shape)) record.shape = shapeStrToEnum.at(shape);
+		else LOG("Collider %s has an unknown shape %s", colliderNode.name(), shape.c_str());
+
+		record.bodyType = Physics::GetEnumFromStr(colliderNode.attribute("bodytype").as_string());
+
+		// Layer defaults match the Physics creators
+		std::string layer = colliderNode.attribute("layer").as_string();
+		if(layerStrToEnum.count(layer)) record.categoryBits = (uint16)layerStrToEnum.at(layer);
+		else if(record.shape == ColliderShape::RECTANGLE_SENSOR) record.categoryBits = (uint16)Layers::SENSOR;
+
+		record.x = colliderNode.attribute("x").as_int();
+		record.y = colliderNode.attribute("y").as_int();
+		record.radius = colliderNode.attribute("radius").as_int();
+		record.width = colliderNode.attribute("w").as_int();
+		record.height = colliderNode.attribute("h").as_int();
+
+		// Point lists are converted to meters here, once, instead of on every launch
+		record.firstVertex = (uint32)points.size();
+		const char *xy = colliderNode.attribute("xy").as_string();
+		if(!PointListParser::Parse(xy, xy + strlen(xy), METER_PER_PIXEL, points))
+		{
+			LOG("Error cooking %s: bad xy in %s", xmlPath.c_str(), colliderNode.name());
+			return false;
+		}
+		record.vertexCount = (uint32)points.size() - record.firstVertex;
+
+		colliders.push_back(record);
+	}
+
+	blobHeader.colliderCount = (uint32)colliders.size();
+	blobHeader.vertexCount = (uint32)points.size();
+
+	SnapshotWriter blob;
+	blob.Reserve(sizeof(ColliderBlobHeader) + colliders.size() * sizeof(ColliderRecord) + points.size() * sizeof(b2Vec2));
+	blob.Write(blobHeader);
+	for(ColliderRecord const &record : colliders)
+	{
+		blob.Write(record);
+	}
+	for(b2Vec2 const &point : points)
+	{
+		blob.Write(point);
+	}
+
+	return SaveWriter::WriteAtomically(blob.GetBuffer(), blobPath);
+}
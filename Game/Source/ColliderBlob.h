@@ -0,0 +1,89 @@
+#ifndef __COLLIDERBLOB_H__
+#define __COLLIDERBLOB_H__
+
+#include "Defs.h"
+#include "Physics.h"
+#include "MappedFile.h"
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#define COLLIDER_BLOB_MAGIC		0x4C434250	// "PBCL"
+#define COLLIDER_BLOB_VERSION	1
+
+enum class ColliderShape : uint8
+{
+	CHAIN,
+	POLYGON,
+	CIRCLE,
+	RECTANGLE,
+	RECTANGLE_SENSOR,
+	UNKNOWN
+};
+
+struct ColliderBlobHeader
+{
+	uint32 magic = COLLIDER_BLOB_MAGIC;
+	uint32 version = COLLIDER_BLOB_VERSION;
+	uint32 recordSize = 0;
+	uint32 colliderCount = 0;
+	uint32 vertexCount = 0;
+
+	// colliders.xml it was cooked from: another size or write time means the blob is stale
+	uint64 sourceSize = 0;
+	uint64 sourceTime = 0;
+};
+
+// One node of colliders.xml. Vertices are already in meters; positions and sizes stay
+// in pixels, the Physics creators take them that way
+struct ColliderRecord
+{
+	char name[SHORT_STR] = {};
+	ColliderShape shape = ColliderShape::UNKNOWN;
+	BodyType bodyType = BodyType::UNKNOWN;
+	uint16 categoryBits = (uint16)Layers::BOARD;
+	uint16 maskBits = (uint16)Layers::BALL;
+	int x = 0;
+	int y = 0;
+	int radius = 0;
+	int width = 0;
+	int height = 0;
+	uint32 firstVertex = 0;
+	uint32 vertexCount = 0;
+};
+
+// colliders.xml cooked into a binary file next to it:
+// header, every record, then every vertex. Read in place through a file mapping.
+class ColliderBlob
+{
+public:
+
+	// The level's index, shared by every entity (and every table of a batch) while one holds it
+	static std::shared_ptr<ColliderBlob const> Acquire(std::string const &xmlPath);
+
+	// Maps the blob of xmlPath, cooking it first when it is missing or stale
+	bool Load(std::string const &xmlPath);
+
+	ColliderRecord const *Find(const char *name) const;
+	b2Vec2 const *GetVertices(ColliderRecord const &record) const;
+	uint32 GetColliderCount() const;
+
+	static std::string GetBlobPath(std::string const &xmlPath);
+	static bool Cook(std::string const &xmlPath, std::string const &blobPath);
+
+private:
+
+	bool Map(std::string const &blobPath);
+	void BuildIndex();
+
+	MappedFile file;
+	ColliderBlobHeader const *header = nullptr;
+	ColliderRecord const *records = nullptr;
+	b2Vec2 const *vertices = nullptr;
+
+	// Records point into the mapping
+	std::unordered_map<std::string, ColliderRecord const *> byName;
+};
+
+#endif // __COLLIDERBLOB_H__
@@ -0,0 +1,53 @@
+#ifndef __COMMANDQUEUE_H__
+#define __COMMANDQUEUE_H__
+
+#include <array>
+#include <atomic>
+#include <stddef.h>
+
+// Fixed size ring for one producer thread and one consumer thread.
+// Push and Pop never lock or allocate: each side only writes its own index.
+template<class T, size_t Capacity>
+class CommandQueue
+{
+	static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "CommandQueue capacity must be a power of two");
+
+public:
+
+	// Producer only. False when the queue is full
+	bool Push(T const &item)
+	{
+		size_t head = writeIndex.load(std::memory_order_relaxed);
+		if(head - readIndex.load(std::memory_order_acquire) == Capacity) return false;
+
+		items[head & (Capacity - 1)] = item;
+		writeIndex.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer only. False when the queue is empty
+	bool Pop(T &item)
+	{
+		size_t tail = readIndex.load(std::memory_order_relaxed);
+		if(tail == writeIndex.load(std::memory_order_acquire)) return false;
+
+		item = items[tail & (Capacity - 1)];
+		readIndex.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool IsEmpty() const
+	{
+		return readIndex.load(std::memory_order_acquire) == writeIndex.load(std::memory_order_acquire);
+	}
+
+private:
+
+	std::array<T, Capacity> items;
+
+	// Kept on separate cache lines so both threads don't fight over one
+	alignas(64) std::atomic<size_t> writeIndex{ 0 };
+	alignas(64) std::atomic<size_t> readIndex{ 0 };
+};
+
+#endif // __COMMANDQUEUE_H__
@@ -76,7 +76,7 @@ inline int DescAlphasort(const struct dirent **c, const struct dirent **d)
 }
 
 
-// Performance macros
+// Performance macros, timer is a PerfTimer (PerfTimer.h)
 #define PERF_START(timer) timer.Start()
 #define PERF_PEEK(timer) LOG("%s took %f ms", __FUNCTION__, timer.ReadMs())
 
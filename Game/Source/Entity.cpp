@@ -0,0 +1,45 @@
+#include "Entity.h"
+#include "Physics.h"
+#include "Snapshot.h"
+
+void Entity::SaveSnapshot(SnapshotWriter &snapshot) const
+{
+	snapshot.Write(active);
+	snapshot.Write(bSpecialFunction);
+
+	bool hasBody = pBody && pBody->body;
+	snapshot.Write(hasBody);
+	if(hasBody) snapshot.Write(pBody->GetSnapshot());
+
+	bool hasAnimation = texture.type == RenderModes::ANIMATION && texture.anim;
+	snapshot.Write(hasAnimation);
+	if(hasAnimation) snapshot.Write(texture.anim->GetState());
+}
+
+bool Entity::LoadSnapshot(SnapshotReader &snapshot)
+{
+	bool hasBody = false;
+	bool hasAnimation = false;
+
+	snapshot.Read(active);
+	snapshot.Read(bSpecialFunction);
+
+	// The snapshot must come from the same table layout
+	if(!snapshot.Read(hasBody) || hasBody != (pBody && pBody->body)) return false;
+	if(hasBody)
+	{
+		BodySnapshot body;
+		if(!snapshot.Read(body)) return false;
+		pBody->RestoreSnapshot(body);
+	}
+
+	if(!snapshot.Read(hasAnimation) || hasAnimation != (texture.type == RenderModes::ANIMATION && texture.anim)) return false;
+	if(hasAnimation)
+	{
+		AnimationState animation;
+		if(!snapshot.Read(animation)) return false;
+		texture.anim->SetState(animation);
+	}
+
+	return !snapshot.Failed();
+}
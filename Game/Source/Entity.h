@@ -14,6 +14,9 @@
 #include <memory>
 
 class PhysBody;
+struct BodyDesc;
+class SnapshotWriter;
+class SnapshotReader;
 
 enum class RenderModes
 {
@@ -80,15 +83,36 @@ enum class SensorFunction
 	UNKNOWN
 };
 
+// What happened to the ball during a game, used to compare table layouts
+struct BallStats
+{
+	uint ballsLost = 0;
+	uint lifetimeSteps = 0;
+	uint sensorHits = 0;
+};
+
+// Score and lives of a table, every ball in play adds to the same ones
+struct TableScore
+{
+	float score = 0;
+	uint scoreMultiplier = 1;
+
+	// Highest and last game's
+	std::pair<uint, uint> scoreList;
+
+	uint hp = 3;
+	BallStats stats;
+};
+
 class Entity
 {
 public:
 
-	explicit Entity() = default;
+	explicit Entity(App* app) : app(app) {}
 
-	explicit Entity(EntityType type) : type(type) {}
+	explicit Entity(App* app, EntityType type) : app(app), type(type) {}
 
-	explicit Entity(pugi::xml_node const &itemNode) : parameters(itemNode)
+	explicit Entity(App* app, pugi::xml_node const &itemNode) : app(app), parameters(itemNode)
 	{
 		const std::unordered_map<std::string, EntityType> entityTypeStrToEnum = CreateEnumMap();
 
@@ -115,7 +139,7 @@ public:
 		this->type = entityTypeStrToEnum.at(name);
 
 		texture.type = RenderModes::UNKNOWN;
-		texture.anim = std::make_unique<Animation>();
+		texture.anim = std::make_unique<Animation>(app);
 	}
 
 	virtual ~Entity() = default;
@@ -125,6 +149,13 @@ public:
 		return true;
 	}
 
+	// Called before Start, the body it fills is created with the rest of the level's
+	// and set as pBody. False when the entity has no body or makes its own in Start
+	virtual bool DescribeBody(BodyDesc &desc)
+	{
+		return false;
+	}
+
 	virtual bool Start()
 	{
 		return true;
@@ -150,6 +181,10 @@ public:
 		return true;
 	}
 
+	// Body, animation and flags; children append their own state after calling these
+	virtual void SaveSnapshot(SnapshotWriter &snapshot) const;
+	virtual bool LoadSnapshot(SnapshotReader &snapshot);
+
 	void Entity::Enable()
 	{
 		if(!active)
@@ -193,14 +228,20 @@ public:
 		//To override
 	};
 
-	virtual uint GetScore() const
+	// Called on the sensor's listener: once when a body gets in, every step while it stays, once when it leaves
+	virtual void OnSensorEnter(PhysBody *sensor, PhysBody *other)
 	{
-		return 0;
+		//To override
+	};
+
+	virtual void OnSensorStay(PhysBody *sensor, PhysBody *other)
+	{
+		//To override
 	};
 
-	virtual std::pair<uint, uint> GetScoreList() const
+	virtual void OnSensorExit(PhysBody *sensor, PhysBody *other)
 	{
-		return std::pair<uint, uint>(0, 0);
+		//To override
 	};
 
 	virtual Texture GetTexture() const
@@ -218,11 +259,6 @@ public:
 		bSpecialFunction = b;
 	};
 
-	virtual void AddMultiplier(uint n)
-	{
-		//To override
-	};
-
 	std::unordered_map<std::string, EntityType> CreateEnumMap() const
 	{
 		const std::unordered_map<std::string, EntityType> aux{
@@ -248,6 +284,9 @@ public:
 		return aux;
 	}
 
+	// Table this entity belongs to
+	App* app = nullptr;
+
 	pugi::xml_node parameters;
 	bool active = true;
 
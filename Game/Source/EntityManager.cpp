@@ -4,11 +4,16 @@
 #include "App.h"
 #include "Textures.h"
 #include "Scene.h"
+#include "Profiler.h"
+#include "Snapshot.h"
+#include "Physics.h"
+#include "PerfTimer.h"
+#include "Render.h"
 
 #include "Defs.h"
 #include "Log.h"
 
-EntityManager::EntityManager() : Module()
+EntityManager::EntityManager(App* app) : Module(app)
 {
 	name.Create("entitymanager");
 }
@@ -35,6 +40,39 @@ bool EntityManager::Awake(pugi::xml_node& config)
 
 bool EntityManager::Start() 
 {
+	// Every body the entities can describe up front is created in one batch
+	std::vector<BodyDesc> descs;
+	std::vector<Entity *> owners;
+	descs.reserve(entities.Count());
+	owners.reserve(entities.Count());
+
+	for(ListItem<Entity *> *item = entities.start; item; item = item->next)
+	{
+		Entity *pEntity = item->data;
+		if(!pEntity->active || pEntity->pBody) continue;
+
+		BodyDesc desc;
+		if(!pEntity->DescribeBody(desc)) continue;
+		descs.push_back(desc);
+		owners.push_back(pEntity);
+	}
+
+	std::vector<PhysBody *> bodies(descs.size());
+	app->physics->CreateBodies(descs.data(), descs.size(), bodies.data());
+	for(size_t i = 0; i < owners.size(); i++)
+	{
+		owners[i]->pBody = bodies[i];
+	}
+
+	if(!balls.empty())
+	{
+		pugi::xml_node const &ballNode = balls.front()->parameters;
+		multiballBalls = ballNode.attribute("multiball").as_uint(MULTIBALL_DEFAULT_BALLS);
+		stressBalls = ballNode.attribute("stress").as_uint(MULTIBALL_DEFAULT_STRESS);
+		multiballSpot.x = ballNode.attribute("multiball_x").as_int(MULTIBALL_DEFAULT_X);
+		multiballSpot.y = ballNode.attribute("multiball_y").as_int(MULTIBALL_DEFAULT_Y);
+	}
+
 	//Iterates over the entities and calls Start
 	for(ListItem<Entity *>*item = entities.start; item; item = item->next)
 	{
@@ -49,6 +87,13 @@ bool EntityManager::Start()
 // Called before quitting
 bool EntityManager::CleanUp()
 {
+	if(ballsSpawned > 0)
+	{
+		LOG("Multiball: %llu balls spawned, %u on the table at most, %.2f us a frame updating and drawing the spawned ones",
+			ballsSpawned, peakBalls, spawnedBallFrames > 0 ? spawnedBallsMs * 1000.0 / (double)spawnedBallFrames : 0.0);
+	}
+	DestroySpawnedBalls();
+
 	ListItem<Entity*>* item = entities.end;
 
 	while (item)
@@ -62,12 +107,62 @@ bool EntityManager::CleanUp()
 	return true;
 }
 
+void EntityManager::SaveSnapshot(SnapshotWriter &snapshot) const
+{
+	snapshot.Write((uint32)entities.Count());
+
+	for(ListItem<Entity *> *item = entities.start; item; item = item->next)
+	{
+		item->data->SaveSnapshot(snapshot);
+	}
+
+	snapshot.Write(table.score);
+	snapshot.Write(table.scoreMultiplier);
+	snapshot.Write(table.scoreList.first);
+	snapshot.Write(table.scoreList.second);
+	snapshot.Write(table.hp);
+	snapshot.Write(table.stats);
+}
+
+bool EntityManager::LoadSnapshot(SnapshotReader &snapshot)
+{
+	if(!CheckSnapshot(snapshot)) return false;
+
+	// Spawned balls aren't saved, a load goes back to the table's own ball
+	DestroySpawnedBalls();
+
+	for(ListItem<Entity *> *item = entities.start; item; item = item->next)
+	{
+		if(!item->data->LoadSnapshot(snapshot)) return false;
+	}
+
+	snapshot.Read(table.score);
+	snapshot.Read(table.scoreMultiplier);
+	snapshot.Read(table.scoreList.first);
+	snapshot.Read(table.scoreList.second);
+	snapshot.Read(table.hp);
+	snapshot.Read(table.stats);
+
+	return !snapshot.Failed();
+}
+
+bool EntityManager::CheckSnapshot(SnapshotReader &snapshot) const
+{
+	uint32 count = 0;
+	if(!snapshot.Read(count) || count != entities.Count())
+	{
+		LOG("Snapshot has %u entities, the table has %u", count, entities.Count());
+		return false;
+	}
+	return true;
+}
+
 Entity *EntityManager::CreateEntity(pugi::xml_node const &itemNode = pugi::xml_node())
 {
 	Entity *entity = nullptr;
 
-	if(std::string(itemNode.name()) == "ball") entity = new Ball(itemNode);
-	else entity = new InteractiveParts(itemNode);
+	if(std::string(itemNode.name()) == "ball") entity = new Ball(app, itemNode);
+	else entity = new InteractiveParts(app, itemNode);
 
 	// Created entities are added to the list
 	AddEntity(entity);
@@ -94,9 +189,9 @@ Entity *EntityManager::CreateEntity(pugi::xml_node const &itemNode = pugi::xml_n
 		return entity;
 	}
 
-	if(!ball && itemName == "ball") 
+	if(balls.empty() && itemName == "ball") 
 	{
-		ball = entity;
+		balls.push_back(static_cast<Ball *>(entity));
 		return entity;
 	}
 
@@ -152,25 +247,133 @@ bool EntityManager::Update(float dt)
 		}
 	}
 
-	if(pinkPower->IsSpecialFunction()) ball->AddMultiplier(1);
+	if(pinkPower->IsSpecialFunction()) table.scoreMultiplier += 1;
+
+	// Time in play scores once per table, however many balls are in
+	if(GetBallsInPlay() > 0) table.score += 0.002f * (float)table.scoreMultiplier * (float)app->GetSimulationSteps();
+
+	if(app->input->GetKey(SDL_SCANCODE_M) == KEY_DOWN) SpawnBalls(multiballBalls);
+	if(app->input->GetKey(SDL_SCANCODE_F11) == KEY_DOWN) SpawnBalls(stressBalls);
 
 	//Iterates over the entities and calls Update
 	for(ListItem<Entity *> *item = entities.start; item; item = item->next)
 	{
 		const Entity *pEntity = item->data;
 		if(!pEntity->active) continue;
+		PROFILE_SCOPE(app->profiler, pEntity->name.c_str(), "entity");
 		if(!item->data->Update()) return false;
 	}
 
+	if(!UpdateSpawnedBalls()) return false;
+
+	DrawLives();
+
 	return true;
 }
 
 uint EntityManager::GetScore() const
 {
-	return ball->GetScore();
+	return (uint)table.score;
 }
 
 std::pair<uint, uint> EntityManager::GetScoreList() const
 {
-	return ball->GetScoreList();
+	return table.scoreList;
+}
+
+BallStats EntityManager::GetBallStats() const
+{
+	return table.stats;
+}
+
+uint EntityManager::GetBallsInPlay() const
+{
+	uint inPlay = 0;
+	for(Ball const *b : balls)
+	{
+		if(b->IsInPlay()) inPlay++;
+	}
+	return inPlay;
+}
+
+void EntityManager::SpawnBalls(uint count)
+{
+	// Once the last ball drained the life is spent, new balls would drain into another one
+	if(balls.empty() || count == 0 || GetBallsInPlay() == 0) return;
+
+	Ball *first = balls.front();
+
+	// Same shape for all of them, only the direction changes: a fan from up-left to up-right
+	std::vector<BodyDesc> descs(count, first->DescribeBall(multiballSpot.x, multiballSpot.y));
+	for(uint i = 0; i < count; i++)
+	{
+		float angle = b2_pi * (0.15f + 0.7f * ((float)i + 0.5f) / (float)count);
+		descs[i].linearVelocity.Set(cosf(angle) * MULTIBALL_SPEED, -sinf(angle) * MULTIBALL_SPEED);
+	}
+
+	std::vector<PhysBody *> bodies(count);
+	app->physics->CreateBodies(descs.data(), descs.size(), bodies.data());
+
+	balls.reserve(balls.size() + count);
+	for(PhysBody *body : bodies)
+	{
+		if(body) balls.push_back(new Ball(app, first->parameters, body, first->texture.image));
+	}
+
+	ballsSpawned += count;
+	peakBalls = MAX(peakBalls, (uint)balls.size());
+	LOG("Multiball: %u balls more, %u on the table", count, (uint)balls.size());
+}
+
+bool EntityManager::UpdateSpawnedBalls()
+{
+	if(balls.size() < 2) return true;
+
+	// One zone for all of them, hundreds of balls would fill the frame's zones
+	PROFILE_SCOPE(app->profiler, "balls", "entity");
+	PerfTimer timer;
+
+	for(size_t i = 1; i < balls.size(); i++)
+	{
+		if(!balls[i]->Update()) return false;
+	}
+
+	// Drained ones go, keeping the order of the rest
+	size_t kept = 1;
+	for(size_t i = 1; i < balls.size(); i++)
+	{
+		if(balls[i]->IsGone()) DestroySpawnedBall(balls[i]);
+		else balls[kept++] = balls[i];
+	}
+	balls.resize(kept);
+
+	spawnedBallsMs += timer.ReadMs();
+	spawnedBallFrames++;
+	return true;
+}
+
+void EntityManager::DestroySpawnedBall(Ball *spawned)
+{
+	spawned->CleanUp();
+	app->physics->DestroyPhysBodyDeferred(spawned->pBody);
+	RELEASE(spawned)
+}
+
+void EntityManager::DestroySpawnedBalls()
+{
+	for(size_t i = 1; i < balls.size(); i++)
+	{
+		DestroySpawnedBall(balls[i]);
+	}
+	if(!balls.empty()) balls.resize(1);
+}
+
+void EntityManager::DrawLives() const
+{
+	if(!app->render || balls.empty()) return;
+
+	for(uint i = 0; i < table.hp; i++)
+	{
+		app->render->DrawTexture(balls.front()->texture.image, 710, 930 - i*(BALL_SIZE + 10));
+	}
 }
@@ -5,11 +5,22 @@
 #include "Entity.h"
 #include "List.h"
 
+#include <vector>
+
+class Ball;
+
+// Multiball defaults, overridden by the <ball> attributes in config.xml
+#define MULTIBALL_DEFAULT_BALLS 2
+#define MULTIBALL_DEFAULT_STRESS 500
+#define MULTIBALL_DEFAULT_X 240
+#define MULTIBALL_DEFAULT_Y 260
+#define MULTIBALL_SPEED 6.0f
+
 class EntityManager : public Module
 {
 public:
 
-	EntityManager();
+	explicit EntityManager(App* app);
 
 	// Destructor
 	virtual ~EntityManager();
@@ -26,6 +37,10 @@ public:
 	// Called before quitting
 	bool CleanUp() final;
 
+	void SaveSnapshot(SnapshotWriter &snapshot) const final;
+	bool LoadSnapshot(SnapshotReader &snapshot) final;
+	bool CheckSnapshot(SnapshotReader &snapshot) const final;
+
 	// Additional methods
 	Entity *CreateEntity(pugi::xml_node const &itemNode);
 
@@ -37,14 +52,46 @@ public:
 
 	std::pair<uint, uint> GetScoreList() const;
 
+	BallStats GetBallStats() const;
+
+	uint GetBallsInPlay() const;
+
+	// Multiball: count more balls fanned out upwards from the table's multiball spot, one body batch.
+	// Nothing while no ball is in play, the round is over then
+	void SpawnBalls(uint count);
+
 	List<Entity*> entities;
 	std::pair<Entity*, Entity*> flippers;
 	Entity *launcher = nullptr;
-	Entity *ball = nullptr;
+
+	// Every ball on the table. The first is the one in config.xml and lives in entities,
+	// the spawned ones after it belong to the EntityManager
+	std::vector<Ball *> balls;
+
+	// Score and lives all the balls add to
+	TableScore table;
 
 	std::vector<Entity *> dividers;
 	Entity *rotatePower = nullptr;
 	Entity *pinkPower = nullptr;
+
+private:
+
+	bool UpdateSpawnedBalls();
+	void DestroySpawnedBall(Ball *spawned);
+	void DestroySpawnedBalls();
+	void DrawLives() const;
+
+	// Multiball settings, from the table's <ball>: M spawns multiballBalls, F11 stressBalls
+	uint multiballBalls = MULTIBALL_DEFAULT_BALLS;
+	uint stressBalls = MULTIBALL_DEFAULT_STRESS;
+	iPoint multiballSpot = iPoint(MULTIBALL_DEFAULT_X, MULTIBALL_DEFAULT_Y);
+
+	// Spawned balls: how many, and what they cost to update and draw
+	uint peakBalls = 1;
+	uint64 ballsSpawned = 0;
+	uint64 spawnedBallFrames = 0;
+	double spawnedBallsMs = 0.0;
 };
 
 #endif // __ENTITYMANAGER_H__
@@ -104,6 +104,9 @@ public:
 	/// @param newOrigin the new origin with respect to the old origin
 	void ShiftOrigin(const b2Vec2& newOrigin);
 
+	/// Build an optimal tree. Expensive, meant for after static geometry is loaded.
+	void RebuildBottomUp() { m_tree.RebuildBottomUp(); }
+
 private:
 
 	friend class b2DynamicTree;
@@ -8,8 +8,9 @@
 #include<string.h>
 
 // Constructor
-Fonts::Fonts() : Module()
+Fonts::Fonts(App* app) : Module(app)
 {
+	name.Create("fonts");
 }
 
 // Destructor
@@ -24,7 +24,7 @@ class Fonts : public Module
 {
 public:
 
-	Fonts();
+	explicit Fonts(App* app);
 	~Fonts();
 
 	// Load Font
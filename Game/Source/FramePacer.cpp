@@ -0,0 +1,112 @@
+#include "FramePacer.h"
+
+#include "SDL/include/SDL.h"
+
+// Spin at least this long before a deadline, SDL_Delay can't be trusted below it
+#define MIN_SPIN_MS		0.25
+#define MAX_SPIN_MS		4.0
+
+FramePacer::FramePacer()
+{
+	frequency = SDL_GetPerformanceFrequency();
+	SetTargetFps(fps);
+}
+
+void FramePacer::SetTargetFps(uint newFps)
+{
+	fps = MAX(newFps, 1u);
+	origin = SDL_GetPerformanceCounter();
+	frameIndex = 0;
+}
+
+uint FramePacer::GetTargetFps() const
+{
+	return fps;
+}
+
+void FramePacer::Wait()
+{
+	frameIndex++;
+	uint64 deadline = DeadlineOf(frameIndex);
+	uint64 now = SDL_GetPerformanceCounter();
+
+	// More than a frame behind (a hitch, the window was idle): start a new schedule instead of rushing to catch up
+	uint64 period = frequency / fps;
+	if(now > deadline + period)
+	{
+		Record((double)(now - deadline) * 1000000.0 / (double)frequency, true);
+		origin = now;
+		frameIndex = 0;
+		return;
+	}
+
+	// Coarse sleep, leaving the learnt oversleep margin to the spin
+	double remainingMs = (deadline > now) ? (double)(deadline - now) * 1000.0 / (double)frequency : 0.0;
+	double spinMs = MAX(MIN_SPIN_MS, MIN(sleepOvershootMs, MAX_SPIN_MS));
+
+	if(remainingMs > spinMs + 1.0)
+	{
+		Uint32 sleepMs = (Uint32)(remainingMs - spinMs);
+		uint64 sleepStart = SDL_GetPerformanceCounter();
+		SDL_Delay(sleepMs);
+		double sleptMs = (double)(SDL_GetPerformanceCounter() - sleepStart) * 1000.0 / (double)frequency;
+
+		// Grow quickly when the OS oversleeps, shrink slowly when it behaves
+		double overshoot = sleptMs - (double)sleepMs;
+		if(overshoot > sleepOvershootMs) sleepOvershootMs = overshoot;
+		else sleepOvershootMs = sleepOvershootMs * 0.99 + overshoot * 0.01;
+	}
+
+	do
+	{
+		now = SDL_GetPerformanceCounter();
+	}
+	while(now < deadline);
+
+	Record((double)(now - deadline) * 1000000.0 / (double)frequency, false);
+}
+
+FramePacingStats FramePacer::GetLastSecondStats() const
+{
+	return lastSecond;
+}
+
+FramePacingStats FramePacer::GetTotalStats() const
+{
+	return total;
+}
+
+uint64 FramePacer::DeadlineOf(uint64 frame) const
+{
+	// Exact for any rate, 144 fps is 144 frames per second and not 1000 / 6
+	return origin + (frame * frequency) / fps;
+}
+
+void FramePacer::Record(double jitterUs, bool missedFrame)
+{
+	uint64 now = SDL_GetPerformanceCounter();
+	if(windowStart == 0) windowStart = now;
+
+	window.frames++;
+	total.frames++;
+	if(missedFrame)
+	{
+		window.missed++;
+		total.missed++;
+	}
+
+	windowJitterSum += jitterUs;
+	totalJitterSum += jitterUs;
+	window.maxJitterUs = MAX(window.maxJitterUs, jitterUs);
+	total.maxJitterUs = MAX(total.maxJitterUs, jitterUs);
+	total.avgJitterUs = totalJitterSum / (double)total.frames;
+
+	if(now - windowStart >= frequency)
+	{
+		window.avgJitterUs = windowJitterSum / (double)window.frames;
+		lastSecond = window;
+		window = FramePacingStats();
+		windowJitterSum = 0.0;
+		windowStart = now;
+	}
+}
@@ -0,0 +1,55 @@
+#ifndef __FRAMEPACER_H__
+#define __FRAMEPACER_H__
+
+#include "Defs.h"
+
+struct FramePacingStats
+{
+	uint frames = 0;
+	uint missed = 0;			// Frames that started more than a whole period late
+	double avgJitterUs = 0.0;	// Distance between the deadline and the actual wake up
+	double maxJitterUs = 0.0;
+};
+
+// Waits for the start of each frame at a fixed rate.
+// Deadlines are absolute (origin + n * period) so rounding errors never add up,
+// the wait sleeps while it is safe to and spins through the last fraction of a millisecond.
+class FramePacer
+{
+public:
+
+	FramePacer();
+
+	// Restarts the schedule from now
+	void SetTargetFps(uint fps);
+	uint GetTargetFps() const;
+
+	// Block until the next frame deadline
+	void Wait();
+
+	// Stats of the last full second, and of the whole run
+	FramePacingStats GetLastSecondStats() const;
+	FramePacingStats GetTotalStats() const;
+
+private:
+
+	uint64 DeadlineOf(uint64 frame) const;
+	void Record(double jitterUs, bool missedFrame);
+
+	uint fps = 60;
+	uint64 frequency = 0;
+	uint64 origin = 0;
+	uint64 frameIndex = 0;
+
+	// How much SDL_Delay oversleeps, learnt while running: the spin margin
+	double sleepOvershootMs = 1.0;
+
+	uint64 windowStart = 0;
+	double windowJitterSum = 0.0;
+	double totalJitterSum = 0.0;
+	FramePacingStats window;
+	FramePacingStats lastSecond;
+	FramePacingStats total;
+};
+
+#endif // __FRAMEPACER_H__
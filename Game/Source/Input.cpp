@@ -8,26 +8,35 @@
 
 #include "SDL/include/SDL.h"
 
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
 #define MAX_KEYS 300
 
-Input::Input() : Module()
+Input::Input(App* app) : Module(app)
 {
 	name.Create("input");
 
 	keyboard = new KeyState[MAX_KEYS];
 	memset(keyboard, KEY_IDLE, sizeof(KeyState) * MAX_KEYS);
 	memset(mouseButtons, KEY_IDLE, sizeof(KeyState) * NUM_MOUSE_BUTTONS);
+	memset(windowEvents, 0, sizeof(windowEvents));
 }
 
 // Destructor
 Input::~Input()
 {
 	delete[] keyboard;
+	delete[] scriptedKeys;
 }
 
 // Called before render is available
 bool Input::Awake(pugi::xml_node& config)
 {
+	// Scripted tables never touch SDL events, several of them may be running at once
+	if(IsScripted()) return LoadScript();
+
 	LOG("Init SDL input event system");
 	bool ret = true;
 	SDL_Init(0);
@@ -44,6 +53,7 @@ bool Input::Awake(pugi::xml_node& config)
 // Called before the first frame
 bool Input::Start()
 {
+	if(IsScripted()) return true;
 	SDL_StopTextInput();
 	return true;
 }
@@ -51,9 +61,16 @@ bool Input::Start()
 // Called each loop iteration
 bool Input::PreUpdate()
 {
-	static SDL_Event event;
+	SDL_Event event;
+
+	const uchar* keys = nullptr;
 
-	const Uint8* keys = SDL_GetKeyboardState(NULL);
+	if(IsScripted())
+	{
+		UpdateScriptedKeys();
+		keys = scriptedKeys;
+	}
+	else keys = SDL_GetKeyboardState(NULL);
 
 	for(int i = 0; i < MAX_KEYS; ++i)
 	{
@@ -82,6 +99,8 @@ bool Input::PreUpdate()
 			mouseButtons[i] = KEY_IDLE;
 	}
 
+	if(IsScripted()) return true;
+
 	while(SDL_PollEvent(&event) != 0)
 	{
 		switch(event.type)
@@ -98,6 +117,7 @@ bool Input::PreUpdate()
 					case SDL_WINDOWEVENT_MINIMIZED:
 					case SDL_WINDOWEVENT_FOCUS_LOST:
 					windowEvents[WE_HIDE] = true;
+					windowEvents[WE_SHOW] = false;
 					break;
 
 					//case SDL_WINDOWEVENT_ENTER:
@@ -106,6 +126,7 @@ bool Input::PreUpdate()
 					case SDL_WINDOWEVENT_MAXIMIZED:
 					case SDL_WINDOWEVENT_RESTORED:
 					windowEvents[WE_SHOW] = true;
+					windowEvents[WE_HIDE] = false;
 					break;
 				}
 			break;
@@ -121,7 +142,7 @@ bool Input::PreUpdate()
 			break;
 
 			case SDL_MOUSEMOTION:
-				int scale = app->win->GetScale();
+				int scale = app->win ? app->win->GetScale() : 1;
 				mouseMotionX = event.motion.xrel / scale;
 				mouseMotionY = event.motion.yrel / scale;
 				mouseX = event.motion.x / scale;
@@ -137,6 +158,7 @@ bool Input::PreUpdate()
 // Called before quitting
 bool Input::CleanUp()
 {
+	if(IsScripted()) return true;
 	LOG("Quitting SDL event subsystem");
 	SDL_QuitSubSystem(SDL_INIT_EVENTS);
 	return true;
@@ -148,6 +170,13 @@ bool Input::GetWindowEvent(EventWindow ev)
 	return windowEvents[ev];
 }
 
+void Input::WaitForEvents(int timeoutMs)
+{
+	// A null event leaves it in the queue for PreUpdate to handle
+	if(!IsScripted()) SDL_WaitEventTimeout(nullptr, timeoutMs);
+	PreUpdate();
+}
+
 iPoint Input::GetMousePosition() const
 {
 	return iPoint(mouseX, mouseY);
@@ -163,4 +192,88 @@ void Input::GetMouseMotion(int& x, int& y) const
 {
 	x = mouseMotionX;
 	y = mouseMotionY;
-}
\ No newline at end of file
+}
+
+void Input::SetScript(const char* path, uint offsetFrames)
+{
+	scriptPath = path;
+	scriptOffset = offsetFrames;
+}
+
+bool Input::IsScripted() const
+{
+	return !scriptPath.empty();
+}
+
+bool Input::LoadScript()
+{
+	std::ifstream file(scriptPath);
+	if(!file.is_open())
+	{
+		LOG("Could not open input script %s", scriptPath.c_str());
+		return false;
+	}
+
+	std::string line;
+	uint lineNumber = 0;
+	while(std::getline(file, line))
+	{
+		lineNumber++;
+		if(line.empty() || line[0] == '#') continue;
+
+		std::istringstream tokens(line);
+		std::string first;
+		tokens >> first;
+		if(first.empty()) continue;
+
+		// "loop <frames>" replays the whole script every <frames> frames
+		if(first == "loop")
+		{
+			tokens >> scriptLoop;
+			continue;
+		}
+
+		ScriptedKey key;
+		std::string keyName;
+		std::string action;
+		key.frame = (uint)atoi(first.c_str());
+		tokens >> keyName >> action;
+
+		key.scancode = SDL_GetScancodeFromName(keyName.c_str());
+		if(key.scancode == SDL_SCANCODE_UNKNOWN || key.scancode >= MAX_KEYS || (action != "press" && action != "release"))
+		{
+			LOG("Input script %s line %u not understood: %s", scriptPath.c_str(), lineNumber, line.c_str());
+			return false;
+		}
+		key.pressed = (action == "press");
+
+		script.push_back(key);
+	}
+
+	std::stable_sort(script.begin(), script.end(), [](ScriptedKey const &a, ScriptedKey const &b) { return a.frame < b.frame; });
+
+	scriptedKeys = new uchar[MAX_KEYS];
+	memset(scriptedKeys, 0, sizeof(uchar) * MAX_KEYS);
+
+	LOG("Loaded input script %s: %u keys, loop every %u frames", scriptPath.c_str(), (uint)script.size(), scriptLoop);
+
+	return true;
+}
+
+void Input::UpdateScriptedKeys()
+{
+	if(scriptFrame++ < scriptOffset) return;
+
+	uint frame = scriptFrame - scriptOffset - 1;
+	if(scriptLoop > 0)
+	{
+		frame %= scriptLoop;
+		if(frame == 0) scriptCursor = 0;
+	}
+
+	while(scriptCursor < script.size() && script[scriptCursor].frame <= frame)
+	{
+		scriptedKeys[script[scriptCursor].scancode] = script[scriptCursor].pressed ? 1 : 0;
+		scriptCursor++;
+	}
+}
@@ -4,6 +4,9 @@
 #include "Module.h"
 #include "Point.h"
 
+#include <string>
+#include <vector>
+
 //#define NUM_KEYS 352
 #define NUM_MOUSE_BUTTONS 3
 //#define LAST_KEYS_PRESSED_BUFFER 50
@@ -31,7 +34,7 @@ class Input : public Module
 
 public:
 
-	Input();
+	explicit Input(App* app);
 
 	// Destructor
 	virtual ~Input();
@@ -60,14 +63,34 @@ public:
 	}
 
 	// Check if a certain window event happened
+	// WE_HIDE and WE_SHOW describe the current state: only one of them is set
 	bool GetWindowEvent(EventWindow ev);
 
+	// Sleep until SDL has an event (or timeoutMs passes), then refresh the input state
+	void WaitForEvents(int timeoutMs);
+
 	// Get mouse / axis position
 	iPoint GetMousePosition() const;
 	void GetMousePosition(int &x, int &y) const;
 	void GetMouseMotion(int& x, int& y) const;
 
+	// Drive the keyboard from a file instead of SDL, starting offsetFrames later
+	void SetScript(const char* path, uint offsetFrames = 0);
+	bool IsScripted() const;
+
 private:
+
+	// One line of an input script: "<frame> <key name> press|release"
+	struct ScriptedKey
+	{
+		uint frame = 0;
+		int scancode = 0;
+		bool pressed = false;
+	};
+
+	bool LoadScript();
+	void UpdateScriptedKeys();
+
 	bool windowEvents[WE_COUNT];
 	KeyState*	keyboard;
 	KeyState mouseButtons[NUM_MOUSE_BUTTONS];
@@ -75,6 +98,15 @@ private:
 	int mouseMotionY;
 	int mouseX;
 	int mouseY;
+
+	// Scripted input
+	std::string scriptPath;
+	std::vector<ScriptedKey> script;
+	uchar *scriptedKeys = nullptr;
+	size_t scriptCursor = 0;
+	uint scriptFrame = 0;
+	uint scriptOffset = 0;
+	uint scriptLoop = 0;
 };
 
 #endif // __INPUT_H__
\ No newline at end of file
@@ -6,6 +6,8 @@
 #include "Render.h"
 #include "Scene.h"
 #include "Physics.h"
+#include "PerfTimer.h"
+#include "Snapshot.h"
 
 #include "Log.h"
 #include "Point.h"
@@ -20,9 +22,9 @@
 #include "PugiXml/src/pugixml.hpp"
 
 
-InteractiveParts::InteractiveParts() : Entity(EntityType::UNKNOWN) {}
+InteractiveParts::InteractiveParts(App* app) : Entity(app, EntityType::UNKNOWN) {}
 
-InteractiveParts::InteractiveParts(pugi::xml_node const &itemNode = pugi::xml_node()) : Entity(itemNode) {}
+InteractiveParts::InteractiveParts(App* app, pugi::xml_node const &itemNode = pugi::xml_node()) : Entity(app, itemNode) {}
 
 InteractiveParts::~InteractiveParts() = default;
 
@@ -37,6 +39,7 @@ bool InteractiveParts::Awake()
 
 bool InteractiveParts::Start() 
 {
+	PERF_ZONE("InteractiveParts::Start");
 
 	position = {
 		parameters.attribute("x").as_int(),
@@ -50,7 +53,7 @@ bool InteractiveParts::Start()
 	if(parameters.attribute("hasfx"))
 	{
 		std::string audioFile = fxLevelPath + name + "." + parameters.attribute("hasfx").as_string();
-		ballCollisionFx = app->audio->LoadFx(audioFile.c_str());
+		if(app->audio) ballCollisionFx = app->audio->LoadFx(audioFile.c_str());
 	}
 
 	CreateFlipperInfo();
@@ -68,15 +71,22 @@ bool InteractiveParts::Update()
 	switch(texture.type)
 	{
 		case RenderModes::IMAGE:
-			app->render->DrawTexture(texture.image, position.x, position.y);
+			if(app->render) app->render->DrawTexture(texture.image, position.x, position.y);
 			break;
 
 		case RenderModes::ANIMATION:
+		{
+			// Animations keep advancing in headless runs, they drive the power-ups
+			SDL_Texture *currentFrame = texture.anim->GetCurrentFrame();
+
+			if(!app->render) break;
+
 			if(std::string(parameters.name()) != "anim_billboard") 
-				app->render->DrawTexture(texture.anim->GetCurrentFrame(), position.x, position.y);
+				app->render->DrawTexture(currentFrame, position.x, position.y);
 			else 
-				app->render->DrawTexture(texture.anim->GetCurrentFrame(), position.x, position.y, nullptr, 1.0F, 0.0, MAXINT, MAXINT, SDL_FLIP_HORIZONTAL);
+				app->render->DrawTexture(currentFrame, position.x, position.y, nullptr, 1.0F, 0.0, MAXINT, MAXINT, SDL_FLIP_HORIZONTAL);
 			break;
+		}
 
 		default:
 			break;
@@ -91,19 +101,19 @@ bool InteractiveParts::Update()
 
 	if(flipperJoint)
 	{
-		if(app->physics->IsDebugActive() && flipperJoint)
+		if(app->physics->IsDebugActive() && flipperJoint && app->render)
 		{
-			auto anchorPos = app->physics->WorldVecToIPoint(flipperJoint->anchor->body->GetPosition());
-			auto mainPos = app->physics->WorldVecToIPoint(pBody->body->GetPosition());
+			auto anchorPos = app->physics->WorldVecToIPoint(flipperJoint->anchor->GetInterpolatedPosition(app->GetSimulationAlpha()));
+			auto mainPos = app->physics->WorldVecToIPoint(pBody->GetInterpolatedPosition(app->GetSimulationAlpha()));
 			app->render->DrawLine(mainPos.x, mainPos.y, anchorPos.x, anchorPos.y, 255, 0, 0);
 		}
 
 		if(app->input->GetKey(SDL_SCANCODE_LEFT) == KEY_DOWN)
 		{
 			if(std::string(parameters.name()) == "flipper_left")
-				flipperJoint->joint->SetMotorSpeed(flipperJoint->motorSpeed * -1.0f);
+				app->physics->SetMotorSpeed(flipperJoint->joint, flipperJoint->motorSpeed * -1.0f);
 			else
-				flipperJoint->joint->SetMotorSpeed(flipperJoint->motorSpeed);
+				app->physics->SetMotorSpeed(flipperJoint->joint, flipperJoint->motorSpeed);
 		}
 	}
 
@@ -114,20 +124,19 @@ bool InteractiveParts::Update()
 		{
 			case KeyState::KEY_DOWN:
 			case KeyState::KEY_REPEAT:
-				launcherJoint->joint->SetMotorSpeed(5);
-				launcherJoint->joint->SetMaxMotorForce(10);
+				app->physics->SetMotor(launcherJoint->joint, 5, 10);
 				break;
 
 			case KeyState::KEY_UP:
-				launcherJoint->joint->SetMotorSpeed(-1500);
-				launcherJoint->joint->SetMaxMotorForce(2000);
+				app->physics->SetMotor(launcherJoint->joint, -1500, 2000);
 				break;
 
 			default:
 				break;
 		}
-		position.x = METERS_TO_PIXELS(pBody->body->GetTransform().p.x) - pBody->width - 15;
-		position.y = METERS_TO_PIXELS(pBody->body->GetTransform().p.y) - pBody->height;
+		b2Vec2 renderPosition = pBody->GetInterpolatedPosition(app->GetSimulationAlpha());
+		position.x = METERS_TO_PIXELS(renderPosition.x) - pBody->width - 15;
+		position.y = METERS_TO_PIXELS(renderPosition.y) - pBody->height;
 	}
 
 	return true;
@@ -138,7 +147,7 @@ bool InteractiveParts::CleanUp()
 	switch(texture.type)
 	{
 		case RenderModes::IMAGE:
-			app->tex->UnLoad(texture.image);
+			if(app->tex) app->tex->UnLoad(texture.image);
 			break;
 
 		case RenderModes::ANIMATION:
@@ -158,7 +167,7 @@ void InteractiveParts::OnCollision(PhysBody *physA, PhysBody *physB)
 	if(physB->ctype == ColliderType::BALL)
 	{
 		if(texture.type == RenderModes::ANIMATION && texture.anim) this->texture.anim->Start();
-		if(ballCollisionFx) app->audio->PlayFx(ballCollisionFx);
+		if(ballCollisionFx && app->audio) app->audio->PlayFx(ballCollisionFx);
 
 		switch(pBody->sensorFunction)
 		{
@@ -179,79 +188,49 @@ void InteractiveParts::OnCollision(PhysBody *physA, PhysBody *physB)
 		
 }
 
-bool InteractiveParts::CreateColliders()
+bool InteractiveParts::DescribeBody(BodyDesc &desc)
 {
 	//EntityType::ANIM are just animations of board, they don't have collisions.
-	if(type == EntityType::ANIM) return true;
+	if(type == EntityType::ANIM || !AcquireColliders()) return false;
 
-	auto collidersFileName = texLevelPath + "colliders" + ".xml";
-
-	pugi::xml_parse_result parseResult = collidersFile.load_file(collidersFileName.c_str());
+	ColliderRecord const *record = colliders->Find(parameters.name());
+	return record && DescribeCollider(*record, desc);
+}
 
-	if(!parseResult)
-	{
-		LOG("Error in InteractiveParts::Start(): %s", parseResult.description());
-		return false;
-	}
+bool InteractiveParts::AcquireColliders()
+{
+	if(colliders) return true;
 
-	pugi::xml_node infoColliders = collidersFile.child("collider_info");
+	auto collidersFileName = texLevelPath + "colliders" + ".xml";
 
-	for(auto const &colliderNode : infoColliders.children())
+	colliders = ColliderBlob::Acquire(collidersFileName);
+	if(!colliders)
 	{
-		if(std::string(colliderNode.name()) == std::string(parameters.name()))
-		{
-			return CreateCollidersBasedOnShape(colliderNode);
-		}
+		LOG("Error in InteractiveParts::Start(): can't load %s", collidersFileName.c_str());
+		return false;
 	}
 
 	return true;
 }
 
-bool InteractiveParts::CreateCollidersBasedOnShape(const pugi::xml_node &colliderNode)
+bool InteractiveParts::CreateColliders()
 {
-	auto bodyTypeChar = colliderNode.attribute("bodytype").as_string();
-	std::string colliderShape = colliderNode.attribute("shape").as_string();
+	if(type == EntityType::ANIM) return true;
+	if(!AcquireColliders()) return false;
 
-	if(!bodyTypeChar || colliderShape.empty())
+	// Normally created with the rest of the level by EntityManager
+	if(!pBody)
 	{
-		LOG("Can't read xml attributes on InteractiveParts::CreateCollidersBasedOnShape\n");
-		LOG("ColliderShape is %s || BodyTypeChar is %s\n", bodyTypeChar ? "true" : "false", colliderShape.empty() ? "false" : "true");
-		return false;
-	}
+		ColliderRecord const *record = colliders->Find(parameters.name());
+		if(!record) return true;
 
-	BodyType typeOfChildren = app->physics->GetEnumFromStr(bodyTypeChar);
-
-	const int posX = colliderNode.attribute("x").as_int();
-	const int posY = colliderNode.attribute("y").as_int();
-	
-	if(colliderShape == "chain" || colliderShape == "polygon")
-	{
-		const std::string xyStr = colliderNode.attribute("xy").as_string();
-		pBody = CreateChainColliders(xyStr, typeOfChildren, colliderShape);
-	}
-	else if(colliderShape == "circle")
-	{
-		const int radius = colliderNode.attribute("radius").as_int();
-		pBody = app->physics->CreateCircle(posX, posY, radius, typeOfChildren);
-	}
-	else if(colliderShape == "rectangle_sensor")
-	{
-		const int width = colliderNode.attribute("w").as_int();
-		const int height = colliderNode.attribute("h").as_int();
-		pBody = app->physics->CreateRectangleSensor(posX, posY, width, height, typeOfChildren);
-	}
-	else if(colliderShape == "rectangle")
-	{
-		const int width = colliderNode.attribute("w").as_int();
-		const int height = colliderNode.attribute("h").as_int();
-		pBody = app->physics->CreateRectangle(posX, posY, width, height, typeOfChildren, 0.0f, 0.1f, (int)Layers::BOARD, (int)Layers::BALL);
-	}
-	else
-	{
-		LOG("Attribute shape of %s not recognized in InteractiveParts::CreateCollidersBasedOnShape", std::string(colliderNode.name()));
-		return false;
+		BodyDesc desc;
+		if(!DescribeCollider(*record, desc)) return false;
+		pBody = app->physics->CreateBody(desc);
 	}
 
+	if(!pBody) return false;
+
 	pBody->listener = this;
 
 	switch(this->type)
@@ -277,36 +256,52 @@ bool InteractiveParts::CreateCollidersBasedOnShape(const pugi::xml_node &collide
 	return true;
 }
 
-PhysBody *InteractiveParts::CreateChainColliders(const std::string &xyStr, BodyType bodyT, std::string const &shape)
+bool InteractiveParts::DescribeCollider(ColliderRecord const &collider, BodyDesc &desc) const
 {
-	static const std::regex r("\\d{1,3}");
-	auto xyStrBegin = std::sregex_iterator(xyStr.begin(), xyStr.end(), r);
-	auto xyStrEnd = std::sregex_iterator();
-
-	std::vector<int> points;
-
-	for(std::sregex_iterator i = xyStrBegin; i != xyStrEnd; ++i)
+	if(collider.bodyType == BodyType::UNKNOWN || collider.shape == ColliderShape::UNKNOWN)
 	{
-		std::smatch match = *i;
-		points.push_back(stoi(match.str()));
+		LOG("Collider %s has no usable bodytype or shape in InteractiveParts::DescribeCollider", collider.name);
+		return false;
 	}
 
-	PhysBody *border;
-	if(shape == "chain")
-	{
-		if(name == "bridge") border = app->physics->CreateChain(0, 0, points.data(), std::distance(xyStrBegin, xyStrEnd), bodyT, 0.0f, (uint)Layers::TOP, (uint)Layers::BALL);
-		else border = app->physics->CreateChain(0, 0, points.data(), std::distance(xyStrBegin, xyStrEnd), bodyT);
-	}
-	else
+	// Vertices come in meters straight from the mapped blob, layers too (see layer in colliders.xml)
+	b2Vec2 const *vertices = colliders->GetVertices(collider);
+	int count = (int)collider.vertexCount;
+
+	switch(collider.shape)
 	{
-		int posX = parameters.child("anchor").attribute("x").as_int();
-		int posY = parameters.child("anchor").attribute("y").as_int();
+		case ColliderShape::CHAIN:
+			desc = Physics::ChainDesc(0, 0, vertices, count, collider.bodyType, 0.0f, collider.categoryBits, collider.maskBits);
+			break;
+
+		case ColliderShape::POLYGON:
+		{
+			int posX = parameters.child("anchor").attribute("x").as_int();
+			int posY = parameters.child("anchor").attribute("y").as_int();
+
+			float restitution = (name == "flipper") ? 5.0f : 0.0f;
+			desc = Physics::PolygonDesc(posX, posY, vertices, count, collider.bodyType, restitution, collider.categoryBits, collider.maskBits);
+			break;
+		}
 
-		if(name == "flipper") border = app->physics->CreatePolygon(posX, posY, points.data(), std::distance(xyStrBegin, xyStrEnd), bodyT, 5.0f, (uint)Layers::KICKERS, (uint)Layers::BALL);
-		else border = app->physics->CreatePolygon(posX, posY, points.data(), std::distance(xyStrBegin, xyStrEnd), bodyT);
+		case ColliderShape::CIRCLE:
+			desc = Physics::CircleDesc(collider.x, collider.y, collider.radius, collider.bodyType, 0.0f, collider.categoryBits, collider.maskBits);
+			break;
+
+		case ColliderShape::RECTANGLE_SENSOR:
+			desc = Physics::RectangleSensorDesc(collider.x, collider.y, collider.width, collider.height, collider.bodyType, collider.categoryBits, collider.maskBits);
+			break;
+
+		case ColliderShape::RECTANGLE:
+			desc = Physics::RectangleDesc(collider.x, collider.y, collider.width, collider.height, collider.bodyType, 0.0f, 0.1f, collider.categoryBits, collider.maskBits);
+			break;
+
+		default:
+			LOG("Attribute shape of %s not recognized in InteractiveParts::DescribeCollider", collider.name);
+			return false;
 	}
-	
-	return border;
+
+	return true;
 }
 
 bool InteractiveParts::CreateFlipperInfo()
@@ -469,7 +464,7 @@ void InteractiveParts::AddTexturesAndAnimationFrames()
 				break;
 
 			case RenderModes::IMAGE:
-				texture.image = app->tex->Load(match0.c_str());
+				if(app->tex) texture.image = app->tex->Load(match0.c_str());
 				break;
 
 			default:
@@ -479,3 +474,47 @@ void InteractiveParts::AddTexturesAndAnimationFrames()
 	}
 	free(nameList);
 }
+
+void InteractiveParts::SaveSnapshot(SnapshotWriter &snapshot) const
+{
+	Entity::SaveSnapshot(snapshot);
+
+	if(flipperJoint)
+	{
+		snapshot.Write(flipperJoint->anchor->GetSnapshot());
+		snapshot.Write(flipperJoint->joint->GetMotorSpeed());
+	}
+
+	if(launcherJoint)
+	{
+		snapshot.Write(launcherJoint->anchor->GetSnapshot());
+		snapshot.Write(launcherJoint->joint->GetMotorSpeed());
+		snapshot.Write(launcherJoint->joint->GetMaxMotorForce());
+	}
+}
+
+bool InteractiveParts::LoadSnapshot(SnapshotReader &snapshot)
+{
+	if(!Entity::LoadSnapshot(snapshot)) return false;
+
+	BodySnapshot anchor;
+	float32 motorSpeed = 0.0f;
+
+	if(flipperJoint)
+	{
+		if(!snapshot.Read(anchor) || !snapshot.Read(motorSpeed)) return false;
+		flipperJoint->anchor->RestoreSnapshot(anchor);
+		flipperJoint->joint->SetMotorSpeed(motorSpeed);
+	}
+
+	if(launcherJoint)
+	{
+		float32 maxMotorForce = 0.0f;
+		if(!snapshot.Read(anchor) || !snapshot.Read(motorSpeed) || !snapshot.Read(maxMotorForce)) return false;
+		launcherJoint->anchor->RestoreSnapshot(anchor);
+		launcherJoint->joint->SetMotorSpeed(motorSpeed);
+		launcherJoint->joint->SetMaxMotorForce(maxMotorForce);
+	}
+
+	return true;
+}
@@ -8,6 +8,7 @@
 #include <regex>
 #include <string>
 #include "Physics.h"
+#include "ColliderBlob.h"
 
 #include "SDL/include/SDL.h"
 #include "PugiXml/src/pugixml.hpp"
@@ -32,14 +33,16 @@ class InteractiveParts : public Entity
 {
 public:
 
-	explicit InteractiveParts();
+	explicit InteractiveParts(App* app);
 
-	explicit InteractiveParts(const pugi::xml_node &itemNode);
+	explicit InteractiveParts(App* app, const pugi::xml_node &itemNode);
 
 	~InteractiveParts() final;
 
 	bool Awake() final;
 
+	bool DescribeBody(BodyDesc &desc) final;
+
 	bool Start() final;
 
 	bool Update() final;
@@ -48,11 +51,14 @@ public:
 
 	void OnCollision(PhysBody *physA, PhysBody *physB) final;
 
+	void SaveSnapshot(SnapshotWriter &snapshot) const final;
+	bool LoadSnapshot(SnapshotReader &snapshot) final;
+
 private:
 
+	bool AcquireColliders();
 	bool CreateColliders();
-	bool CreateCollidersBasedOnShape(const pugi::xml_node &colliderAttributes);
-	PhysBody *CreateChainColliders(const std::string &xyStr, BodyType bodyT, std::string const &shape);
+	bool DescribeCollider(ColliderRecord const &collider, BodyDesc &desc) const;
 
 	bool CreateFlipperInfo();
 
@@ -65,7 +71,8 @@ private:
 	std::unique_ptr<FlipperInfo> flipperJoint;
 	std::unique_ptr<LauncherInfo> launcherJoint;
 
-	pugi::xml_document collidersFile;
+	// Shared with every other part of the level
+	std::shared_ptr<ColliderBlob const> colliders;
 };
 
 #endif // __ITEM_H__
\ No newline at end of file
@@ -0,0 +1,91 @@
+#include "JobSystem.h"
+
+#include <thread>
+
+JobSystem::JobSystem(uint workerCount)
+{
+	if(workerCount == 0) workerCount = std::thread::hardware_concurrency();
+	if(workerCount == 0) workerCount = 1;
+
+	for(uint i = 0; i < workerCount; i++)
+	{
+		queues.push_back(std::make_unique<WorkerQueue>());
+	}
+}
+
+void JobSystem::Submit(std::function<void()> job)
+{
+	queues[nextQueue]->jobs.push_back(std::move(job));
+	nextQueue = (nextQueue + 1) % queues.size();
+}
+
+void JobSystem::Run()
+{
+	std::vector<std::thread> workers;
+
+	// The calling thread works too, as worker 0
+	for(uint i = 1; i < queues.size(); i++)
+	{
+		workers.emplace_back(&JobSystem::WorkerLoop, this, i);
+	}
+
+	WorkerLoop(0);
+
+	for(auto &worker : workers)
+	{
+		worker.join();
+	}
+}
+
+uint JobSystem::GetWorkerCount() const
+{
+	return queues.size();
+}
+
+uint JobSystem::GetStolenCount() const
+{
+	return stolenJobs;
+}
+
+void JobSystem::WorkerLoop(uint worker)
+{
+	std::function<void()> job;
+
+	// Jobs don't spawn jobs, so once every queue is empty there's nothing left to wait for
+	while(PopLocal(worker, job) || Steal(worker, job))
+	{
+		job();
+	}
+}
+
+bool JobSystem::PopLocal(uint worker, std::function<void()> &job)
+{
+	WorkerQueue &queue = *queues[worker];
+	std::lock_guard<std::mutex> guard(queue.lock);
+
+	if(queue.jobs.empty()) return false;
+
+	job = std::move(queue.jobs.back());
+	queue.jobs.pop_back();
+
+	return true;
+}
+
+bool JobSystem::Steal(uint thief, std::function<void()> &job)
+{
+	for(uint i = 1; i < queues.size(); i++)
+	{
+		WorkerQueue &victim = *queues[(thief + i) % queues.size()];
+		std::lock_guard<std::mutex> guard(victim.lock);
+
+		if(victim.jobs.empty()) continue;
+
+		job = std::move(victim.jobs.front());
+		victim.jobs.pop_front();
+		stolenJobs++;
+
+		return true;
+	}
+
+	return false;
+}
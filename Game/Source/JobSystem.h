@@ -0,0 +1,51 @@
+#ifndef __JOBSYSTEM_H__
+#define __JOBSYSTEM_H__
+
+#include "Defs.h"
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Runs a batch of independent jobs on a pool of threads.
+// Every worker owns a queue; when it runs dry it steals from the others,
+// so jobs of very different lengths still keep every core busy.
+class JobSystem
+{
+public:
+
+	// 0 uses one worker per hardware thread
+	explicit JobSystem(uint workerCount = 0);
+
+	// Queue a job, must be called before Run()
+	void Submit(std::function<void()> job);
+
+	// Run every submitted job and wait for all of them
+	void Run();
+
+	uint GetWorkerCount() const;
+	uint GetStolenCount() const;
+
+private:
+
+	struct WorkerQueue
+	{
+		std::mutex lock;
+		std::deque<std::function<void()>> jobs;
+	};
+
+	void WorkerLoop(uint worker);
+
+	// Own queue is used as a stack (newest first), others are robbed from the front
+	bool PopLocal(uint worker, std::function<void()> &job);
+	bool Steal(uint thief, std::function<void()> &job);
+
+	std::vector<std::unique_ptr<WorkerQueue>> queues;
+	uint nextQueue = 0;
+	std::atomic<uint> stolenJobs{ 0 };
+};
+
+#endif // __JOBSYSTEM_H__
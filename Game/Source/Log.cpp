@@ -5,9 +5,10 @@
 
 void Log(const char file[], int line, const char* format, ...)
 {
-	static char tmpString1[4096];
-	static char tmpString2[4096];
-	static va_list ap;
+	// Locals, several tables may be logging from different threads
+	char tmpString1[4096];
+	char tmpString2[4096];
+	va_list ap;
 
 	// Construct the string from variable arguments
 	va_start(ap, format);
@@ -1,6 +1,9 @@
 #pragma once
 
 #include "App.h"
+#include "BatchRunner.h"
+#include "ColliderBlob.h"
+#include "PointListParser.h"
 
 #include "Defs.h"
 #include "Log.h"
@@ -30,11 +33,22 @@ enum MainState
 	RESTART
 };
 
-App* app = NULL;
-
 int main(int argc, char* args[])
 {
+	// Balancing runs: many headless tables at once, no main loop here
+	if(BatchRunner::IsRequested(argc, args)) return BatchRunner(argc, args).Run();
+
+	// Build step: cook a level's colliders.xml into its blob and quit. The game also does it when the blob is stale
+	for(int i = 1; i + 1 < argc; i++)
+	{
+		if(strcmp(args[i], "--cook") == 0) return ColliderBlob::Cook(args[i + 1], ColliderBlob::GetBlobPath(args[i + 1])) ? EXIT_SUCCESS : EXIT_FAILURE;
+
+		// Microbenchmark of the colliders.xml point list parser against the old regex tokenizer
+		if(strcmp(args[i], "--bench-points") == 0) return PointListParser::Benchmark(args[i + 1], (i + 2 < argc) ? atoi(args[i + 2]) : 2000);
+	}
+
 	LOG("Engine starting ...");
+	App* app = NULL;
 	MainState state = CREATE;
 	int result = EXIT_FAILURE;
 
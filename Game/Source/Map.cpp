@@ -22,6 +22,7 @@
 
 
 /*		Move position by amount if condition is true.
+*		Fonts: Fonts module used to write str
 *		Position: Current Position
 *		Amount: How much to move the position
 *		lambdaValue: Number that will be evaluated
@@ -30,17 +31,17 @@
 *		font: font to use
 */
 template<class UnaryPred> 
-void OffsetDrawPosition(iPoint &position, iPoint amount, float lambdaValue = 1, UnaryPred predicate = true, std::string const &str = "", uint font = 0)
+void OffsetDrawPosition(Fonts const *fonts, iPoint &position, iPoint amount, float lambdaValue = 1, UnaryPred predicate = true, std::string const &str = "", uint font = 0)
 {
 	if(!predicate(lambdaValue)) return;
 
-	if(str != "") app->fonts->Blit(position.x, position.y, font, str.c_str());
+	if(str != "") fonts->Blit(position.x, position.y, font, str.c_str());
 
 	position += amount;
 }
 
 
-Map::Map() : Module()
+Map::Map(App* app) : Module(app)
 {
 	name.Create("map");
 }
@@ -64,6 +65,8 @@ bool Map::Awake(pugi::xml_node& config)
 
 bool Map::Start()
 {
+	if(!app->fonts) return true;
+
 	std::string fontWhiteFile = fontsPath + "font_white.png";
 	std::string fontOrangeFile = fontsPath + "font_orange.png";
 
@@ -76,11 +79,13 @@ bool Map::Start()
 }
 bool Map::PostUpdate()
 {
+	if(!app->fonts) return true;
 	DrawUI();
 	return true;
 }
 void Map::Draw()
 {
+	if(!app->render) return;
 	app->render->DrawTexture(backgroundImage, 0, 0);
 	app->render->DrawTexture(boardImage, 0, 0);
 	
@@ -91,7 +96,7 @@ bool Map::CleanUp()
 {
 	LOG("Unloading map");
 
-	if(boardImage) app->tex->UnLoad(boardImage);
+	if(boardImage && app->tex) app->tex->UnLoad(boardImage);
 
 	return true;
 }
@@ -101,6 +106,9 @@ bool Map::Load()
 {
 	uint aux = app->GetLevelNumber();
 
+	// Headless runs have nothing to show or play
+	if(!app->tex || !app->audio) return true;
+
 	auto levelFilePath = texturePath + "level_" + std::to_string(aux) + "/";
 	auto imageFolder = levelFilePath + "board.png";
 	boardImage = app->tex->Load(imageFolder.c_str());
@@ -119,6 +127,7 @@ void Map::DrawUI() const
 	DrawScores(565, 125, -4, -10.0f);
 	DrawFPS(5, 5);
 	DrawGravity(5, 75);
+	if(app->physics->IsProfileHudActive()) DrawPhysicsProfile(5, 135);
 }
 
 void Map::DrawGravity(int x, int y) const
@@ -146,8 +155,8 @@ void Map::DrawGravity(int x, int y) const
 	app->fonts->Blit(pos.x, pos.y, fontOrange, gravX.c_str());
 
 
-	OffsetDrawPosition(pos, iPoint(15, 0), gravity.x, [](float n) { return n < 0; });
-	OffsetDrawPosition(pos, iPoint(15, 0), gravity.x, [](float n) { return abs(n) > 9; });
+	OffsetDrawPosition(app->fonts, pos, iPoint(15, 0), gravity.x, [](float n) { return n < 0; });
+	OffsetDrawPosition(app->fonts, pos, iPoint(15, 0), gravity.x, [](float n) { return abs(n) > 9; });
 
 	pos.x += 45;
 
@@ -159,14 +168,70 @@ void Map::DrawGravity(int x, int y) const
 
 	app->fonts->Blit(pos.x, pos.y, fontOrange, gravY.c_str());
 
-	OffsetDrawPosition(pos, iPoint(15, 0), gravity.y, [](float n) { return n < 0; });
-	OffsetDrawPosition(pos, iPoint(15, 0), gravity.y, [](float n) { return abs(n) > 9; });
+	OffsetDrawPosition(app->fonts, pos, iPoint(15, 0), gravity.y, [](float n) { return n < 0; });
+	OffsetDrawPosition(app->fonts, pos, iPoint(15, 0), gravity.y, [](float n) { return abs(n) > 9; });
 
 	pos.x += 45;
 
 	app->fonts->Blit(pos.x, pos.y, fontWhite, "'"); 
 }
 
+void Map::DrawPhysicsProfile(int x, int y) const
+{
+	StepProfileWindow profile = app->physics->GetStepProfile();
+	b2Profile const &mean = profile.mean.time;
+	b2Profile const &peak = profile.peak.time;
+
+	// Box2D times are in ms, shown in us. The font has no m or x
+	struct ProfileRow
+	{
+		const char *label;
+		float32 mean;
+		float32 peak;
+	};
+	ProfileRow const times[] = {
+		{ "step", mean.step, peak.step },
+		{ "collide", mean.collide, peak.collide },
+		{ "solve", mean.solve, peak.solve },
+		{ " init", mean.solveInit, peak.solveInit },
+		{ " velocity", mean.solveVelocity, peak.solveVelocity },
+		{ " position", mean.solvePosition, peak.solvePosition },
+		{ " toi", mean.solveTOI, peak.solveTOI },
+		{ "broadphase", mean.broadphase, peak.broadphase }
+	};
+	ProfileRow const counts[] = {
+		{ "substeps", (float32)profile.mean.substeps, (float32)profile.peak.substeps },
+		{ "bodies", (float32)profile.mean.bodies, (float32)profile.peak.bodies },
+		{ "contacts", (float32)profile.mean.contacts, (float32)profile.peak.contacts },
+		{ "tree leaves", (float32)profile.mean.proxies, (float32)profile.peak.proxies }
+	};
+
+	app->fonts->Blit(x, y, fontOrange, "Physics us");
+	app->fonts->Blit(x + 180, y, fontOrange, "avg");
+	app->fonts->Blit(x + 270, y, fontOrange, "peak");
+
+	for(ProfileRow const &row : times)
+	{
+		y += 20;
+		std::stringstream meanText;
+		meanText << std::fixed << std::setprecision(1) << row.mean * 1000.0f;
+		std::stringstream peakText;
+		peakText << std::fixed << std::setprecision(1) << row.peak * 1000.0f;
+
+		app->fonts->Blit(x, y, fontWhite, row.label);
+		app->fonts->Blit(x + 180, y, fontWhite, meanText.str().c_str());
+		app->fonts->Blit(x + 270, y, fontWhite, peakText.str().c_str());
+	}
+
+	for(ProfileRow const &row : counts)
+	{
+		y += 20;
+		app->fonts->Blit(x, y, fontWhite, row.label);
+		app->fonts->Blit(x + 180, y, fontOrange, std::to_string((int)row.mean).c_str());
+		app->fonts->Blit(x + 270, y, fontOrange, std::to_string((int)row.peak).c_str());
+	}
+}
+
 void Map::DrawFPS(int x, int y) const
 {
 	std::string vSyncActive;
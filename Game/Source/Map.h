@@ -12,7 +12,7 @@ class Map : public Module
 {
 public:
 
-	Map();
+	explicit Map(App* app);
 
 	// Destructor
 	virtual ~Map();
@@ -41,6 +41,7 @@ public:
 	void DrawGravity(int x, int y) const;
 	void DrawFPS(int x, int y) const;
 	void DrawScores(int x, int y, int offsetY, double angle) const;
+	void DrawPhysicsProfile(int x, int y) const;
 
 	
 	//void OffsetDrawPosition(iPoint &position, iPoint amount, bool condition = true, std::string const &str = "", uint font = 0);
@@ -0,0 +1,38 @@
+#ifndef __MAPPEDFILE_H__
+#define __MAPPEDFILE_H__
+
+#include <stddef.h>
+
+// Read only view of a whole file mapped into memory.
+// Pages are loaded on first touch and shared with every other view of the same file.
+class MappedFile
+{
+public:
+
+	MappedFile() = default;
+	~MappedFile();
+
+	MappedFile(MappedFile const &) = delete;
+	MappedFile &operator=(MappedFile const &) = delete;
+
+	bool Open(const char *path);
+	void Close();
+
+	bool IsOpen() const;
+	const char *GetData() const;
+	size_t GetSize() const;
+
+private:
+
+	const char *data = nullptr;
+	size_t size = 0;
+
+#ifdef _WIN32
+	void *file = nullptr;
+	void *mapping = nullptr;
+#else
+	int file = -1;
+#endif
+};
+
+#endif // __MAPPEDFILE_H__
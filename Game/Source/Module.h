@@ -7,12 +7,14 @@
 
 class App;
 class PhysBody;
+class SnapshotWriter;
+class SnapshotReader;
 
 class Module
 {
 public:
 
-	Module() = default;
+	explicit Module(App* app) : app(app) {}
 
 	void Init()
 	{
@@ -55,6 +57,22 @@ public:
 		return true;
 	}
 
+	// Binary snapshot of what changes while playing, see Snapshot.h
+	virtual void SaveSnapshot(SnapshotWriter&) const
+	{
+	}
+
+	virtual bool LoadSnapshot(SnapshotReader&)
+	{
+		return true;
+	}
+
+	// Looks at its section before any module loads, false refuses the whole snapshot
+	virtual bool CheckSnapshot(SnapshotReader&) const
+	{
+		return true;
+	}
+
 	virtual bool LoadState(pugi::xml_node&)
 	{
 		return true;
@@ -73,6 +91,9 @@ public:
 	SString name;
 	bool active = false;
 
+	// Table this module belongs to
+	App* app = nullptr;
+
 };
 
 #endif // __MODULE_H__
\ No newline at end of file
@@ -0,0 +1,120 @@
+#include "PerfTimer.h"
+
+#include "Log.h"
+
+#include "SDL/include/SDL.h"
+
+#include <algorithm>
+#include <memory>
+
+// ---------------------------------------------
+PerfTimer::PerfTimer()
+{
+	Start();
+}
+
+void PerfTimer::Start()
+{
+	startTime = SDL_GetPerformanceCounter();
+}
+
+double PerfTimer::ReadMs() const
+{
+	return (double)ReadTicks() * 1000.0 / (double)SDL_GetPerformanceFrequency();
+}
+
+uint64 PerfTimer::ReadTicks() const
+{
+	return SDL_GetPerformanceCounter() - startTime;
+}
+
+// ---------------------------------------------
+PerfCounter::PerfCounter(const char *name) : name(name)
+{
+	samples.reserve(1024);
+}
+
+void PerfCounter::AddSample(double ms)
+{
+	std::lock_guard<std::mutex> guard(lock);
+
+	uint64 now = SDL_GetPerformanceCounter();
+	if(samples.empty()) windowStart = now;
+	else if(now - windowStart >= SDL_GetPerformanceFrequency())
+	{
+		CloseWindow();
+		windowStart = now;
+	}
+
+	samples.push_back(ms);
+}
+
+void PerfCounter::Flush()
+{
+	std::lock_guard<std::mutex> guard(lock);
+	if(!samples.empty()) CloseWindow();
+}
+
+PerfStats PerfCounter::GetLastStats() const
+{
+	std::lock_guard<std::mutex> guard(lock);
+	return lastStats;
+}
+
+std::string const &PerfCounter::GetName() const
+{
+	return name;
+}
+
+void PerfCounter::CloseWindow()
+{
+	PerfStats stats;
+	stats.calls = samples.size();
+
+	double sum = 0.0;
+	stats.minMs = samples[0];
+	stats.maxMs = samples[0];
+	for(double sample : samples)
+	{
+		sum += sample;
+		stats.minMs = MIN(stats.minMs, sample);
+		stats.maxMs = MAX(stats.maxMs, sample);
+	}
+	stats.avgMs = sum / (double)samples.size();
+
+	size_t p99 = (samples.size() * 99) / 100;
+	std::nth_element(samples.begin(), samples.begin() + p99, samples.end());
+	stats.p99Ms = samples[p99];
+
+	LOG("%s: %u calls, min %.3f avg %.3f max %.3f p99 %.3f ms", name.c_str(), stats.calls, stats.minMs, stats.avgMs, stats.maxMs, stats.p99Ms);
+
+	lastStats = stats;
+	samples.clear();
+}
+
+// ---------------------------------------------
+static std::mutex registryLock;
+static std::vector<std::unique_ptr<PerfCounter>> registry;
+
+PerfCounter &PerfCounters::Get(const char *name)
+{
+	std::lock_guard<std::mutex> guard(registryLock);
+
+	for(auto const &counter : registry)
+	{
+		if(counter->GetName() == name) return *counter;
+	}
+
+	registry.push_back(std::make_unique<PerfCounter>(name));
+	return *registry.back();
+}
+
+void PerfCounters::FlushAll()
+{
+	std::lock_guard<std::mutex> guard(registryLock);
+
+	for(auto const &counter : registry)
+	{
+		counter->Flush();
+	}
+}
@@ -0,0 +1,109 @@
+#ifndef __PERFTIMER_H__
+#define __PERFTIMER_H__
+
+#include "Defs.h"
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Zones are only measured in debug builds, define PERF_ZONES to get them in release too
+#if defined(_DEBUG) && !defined(PERF_ZONES)
+#define PERF_ZONES
+#endif
+
+// High resolution timer on top of the SDL performance counter
+class PerfTimer
+{
+public:
+
+	// Starts counting on construction
+	PerfTimer();
+
+	void Start();
+	double ReadMs() const;
+	uint64 ReadTicks() const;
+
+private:
+
+	uint64 startTime = 0;
+};
+
+// Timings of one counter over one second
+struct PerfStats
+{
+	uint calls = 0;
+	double minMs = 0.0;
+	double avgMs = 0.0;
+	double maxMs = 0.0;
+	double p99Ms = 0.0;
+};
+
+// Named accumulator of zone timings, logs its stats every second it is used
+class PerfCounter
+{
+public:
+
+	explicit PerfCounter(const char *name);
+
+	void AddSample(double ms);
+
+	// Log and reset the current window, even if the second isn't over
+	void Flush();
+
+	PerfStats GetLastStats() const;
+	std::string const &GetName() const;
+
+private:
+
+	void CloseWindow();
+
+	std::string name;
+
+	// Tables running in parallel may share a counter
+	mutable std::mutex lock;
+
+	uint64 windowStart = 0;
+	std::vector<double> samples;
+	PerfStats lastStats;
+};
+
+// Registry of every counter, they live until the program ends
+class PerfCounters
+{
+public:
+
+	static PerfCounter &Get(const char *name);
+	static void FlushAll();
+};
+
+// Adds the time spent in its scope to a counter
+class PerfZone
+{
+public:
+
+	explicit PerfZone(PerfCounter &counter) : counter(counter) {}
+
+	~PerfZone()
+	{
+		counter.AddSample(timer.ReadMs());
+	}
+
+private:
+
+	PerfCounter &counter;
+	PerfTimer timer;
+};
+
+#define PERF_CONCAT_INNER(a, b) a##b
+#define PERF_CONCAT(a, b) PERF_CONCAT_INNER(a, b)
+
+#ifdef PERF_ZONES
+#define PERF_ZONE(name) static PerfCounter &PERF_CONCAT(perfCounter, __LINE__) = PerfCounters::Get(name); PerfZone PERF_CONCAT(perfZone, __LINE__)(PERF_CONCAT(perfCounter, __LINE__))
+#define PERF_FLUSH() PerfCounters::FlushAll()
+#else
+#define PERF_ZONE(name) ((void)0)
+#define PERF_FLUSH() ((void)0)
+#endif
+
+#endif // __PERFTIMER_H__
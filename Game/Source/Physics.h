@@ -1,8 +1,17 @@
 #pragma once
 #include "Module.h"
 #include "Entity.h"
-
+#include "CommandQueue.h"
+#include "Pool.h"
+#include "RewindBuffer.h"
+#include "WorldFork.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 #include <unordered_map>
+#include <vector>
 
 #include "Box2D/Box2D/Box2D.h"
 
@@ -94,6 +103,167 @@ struct RevoluteJointSingleProperty
 	RevoluteJointSingleProperty::~RevoluteJointSingleProperty() {};
 };
 
+#define CONTACT_QUEUE_SIZE 256
+
+// Fast bullets split a fixed step so they never move more than their radius
+// or the thinnest collider in one go
+#define MAX_SUBSTEPS 8
+
+// Recorded by the contact listener during b2World::Step, dispatched after it
+struct ContactEvent
+{
+	PhysBody *bodyA = nullptr;
+	PhysBody *bodyB = nullptr;
+	bool begin = true;
+	bool sensorA = false;
+	bool sensorB = false;
+};
+
+// A body inside a sensor, counted per touching fixture
+struct SensorOverlap
+{
+	PhysBody *sensor = nullptr;
+	PhysBody *other = nullptr;
+	uint fixtureContacts = 0;
+};
+
+#define PHYSICS_COMMAND_QUEUE_SIZE 256
+#define PHYSICS_THREAD_WAIT_MS 2
+
+#define PHYSICS_DEFAULT_BODIES 128
+
+// Rewind history defaults, overridden by <rewind> in config.xml
+#define REWIND_DEFAULT_SECONDS 5.0f
+#define REWIND_DEFAULT_BODIES 32
+#define REWIND_DEFAULT_JOINTS 8
+
+// Trajectory prediction defaults, overridden by <prediction> in config.xml
+#define PREDICTION_DEFAULT_SECONDS 1.5f
+#define PREDICTION_DEFAULT_BUDGET_US 250.0f
+
+// How far (meters) a live ball may be from its predicted path for the path to still hold
+#define PREDICTION_TOLERANCE 0.005f
+
+// Step profile: the HUD shows the average and peak of this many fixed steps
+#define PROFILE_WINDOW_STEPS 60
+#define PROFILE_DEFAULT_CSV "physics_profile.csv"
+
+// What the main thread asks the physics thread to do, applied in order
+enum class PhysicsCommandType
+{
+	STEP,
+	REVOLUTE_MOTOR,
+	PRISMATIC_MOTOR,
+	GRAVITY,
+	DESTROY_BODY
+};
+
+struct PhysicsCommand
+{
+	PhysicsCommandType type = PhysicsCommandType::STEP;
+	uint steps = 0;
+	float32 timeStep = 0.0f;
+	b2Joint *joint = nullptr;
+	float32 motorSpeed = 0.0f;
+	float32 maxMotorForce = 0.0f;
+	b2Vec2 gravity = b2Vec2(0.0f, 0.0f);
+	PhysBody *body = nullptr;
+};
+
+// Where a body was before and after the last step of a frame
+struct BodyTransform
+{
+	PhysBody *body = nullptr;
+	b2Transform previous;
+	b2Transform current;
+};
+
+// Published by the physics thread, read by the main thread
+struct PhysicsFrame
+{
+	std::vector<BodyTransform> transforms;
+	std::vector<ContactEvent> events;
+	std::vector<PhysBody*> destroyed;
+};
+
+// A ball the prediction follows, its body in the fork and where it was live when last looked at
+struct PredictedBall
+{
+	PhysBody *body = nullptr;
+	b2Body const *mirror = nullptr;
+	b2Vec2 position;
+};
+
+// Where one fixed step went: b2Profile in ms summed over its substeps, and the world it stepped
+struct StepProfile
+{
+	b2Profile time = {};
+	uint substeps = 0;
+	int32 bodies = 0;
+	int32 contacts = 0;
+	int32 proxies = 0;
+};
+
+struct StepProfileWindow
+{
+	StepProfile mean;
+	StepProfile peak;
+	uint steps = 0;
+};
+
+// Everything Box2D needs to put a body back where it was
+struct BodySnapshot
+{
+	b2Vec2 position;
+	float32 angle;
+	b2Vec2 linearVelocity;
+	float32 angularVelocity;
+	bool awake;
+};
+
+enum class FixtureShape
+{
+	RECTANGLE,
+	CIRCLE,
+	POLYGON,
+	CHAIN
+};
+
+// One fixture. Sizes in pixels, vertices in meters; the vertices only have to live until the body is created
+struct FixtureDesc
+{
+	FixtureShape shape = FixtureShape::RECTANGLE;
+	int width = 0;
+	int height = 0;
+	int radius = 0;
+	const b2Vec2 *vertices = nullptr;
+	int vertexCount = 0;
+	float32 density = 1.0f;
+	float32 restitution = 0.0f;
+	bool sensor = false;
+	uint16 categoryBits = (uint16)Layers::BOARD;
+	uint16 maskBits = (uint16)Layers::BALL;
+};
+
+// Everything Physics needs to create a body, position in pixels and angle in degrees
+struct BodyDesc
+{
+	BodyType type = BodyType::STATIC;
+	int x = 0;
+	int y = 0;
+	int angle = 0;
+	float32 gravityScale = 1.0f;
+	bool bullet = false;
+	FixtureDesc fixture;
+
+	// Meters per second, dynamic bodies only
+	b2Vec2 linearVelocity = b2Vec2(0.0f, 0.0f);
+
+	// Given to the PhysBody, GetPosition offsets by them
+	int width = 0;
+	int height = 0;
+};
+
 // Small class to return to other modules to track position and rotation of physics bodies
 class PhysBody
 {
@@ -102,14 +272,34 @@ public:
 
 	~PhysBody() = default;
 
+	// Where the collider is: the body's transform, plus its placement on it when baked
+	b2Transform GetTransform() const;
 	void GetPosition(int& x, int& y) const;
 	float GetRotation() const;
 	bool Contains(int x, int y) const;
+
+	// Render helper: blend between the last two fixed steps
+	b2Vec2 GetInterpolatedPosition(float alpha) const;
 	int RayCast(int x1, int y1, int x2, int y2, float& normal_x, float& normal_y) const;
 
+	BodySnapshot GetSnapshot() const;
+	void RestoreSnapshot(BodySnapshot const &state);
+
+	// Slot in the Physics pool, resolves through Physics::GetPhysBody until the body is destroyed
+	PoolHandle handle;
+
 	int width= 0;
 	int height = 0;
 	b2Body* body = nullptr;
+
+	// Baked static geometry shares its layer's body: fixture is this collider's own one
+	// and local where it sits on the body. nullptr and identity otherwise
+	b2Fixture *fixture = nullptr;
+	b2Transform local = b2Transform(b2Vec2(0.0f, 0.0f), b2Rot(0.0f));
+
+	// Last two fixed steps, only written by the main thread
+	b2Transform previousTransform;
+	b2Transform currentTransform;
 	Entity* listener = nullptr;
 	ColliderType ctype = ColliderType::UNKNOWN;
 	SensorFunction sensorFunction;
@@ -121,22 +311,67 @@ class Physics : public Module, public b2ContactListener
 public:
 
 	// Constructors & Destructors
-	Physics();
+	explicit Physics(App* app);
 	~Physics() final;
 
 	// Main module steps
+	bool Awake(pugi::xml_node &config) final;
 	bool Start() final;
 	bool PreUpdate() final;
 	bool PostUpdate() final;
 	bool CleanUp() final;
 
+	void SaveSnapshot(SnapshotWriter &snapshot) const final;
+	bool LoadSnapshot(SnapshotReader &snapshot) final;
+
 	// Create basic physics objects
 	PhysBody* CreateRectangle(int x, int y, int width, int height, BodyType type, float32 gravityScale = 1.0f, float rest = 1.0f, uint16 cat = (uint16)Layers::BOARD, uint16 mask = (uint16)Layers::BALL);
-	PhysBody* CreateCircle(int x, int y, int radius, BodyType type, float rest = 0.0f, uint16 cat = (uint16)Layers::BOARD, uint16 mask = (uint16)Layers::BALL);
+	PhysBody* CreateCircle(int x, int y, int radius, BodyType type, float rest = 0.0f, uint16 cat = (uint16)Layers::BOARD, uint16 mask = (uint16)Layers::BALL, bool bullet = false);
 	PhysBody* CreatePolygon(int x, int y, const int* const points, int size, BodyType type, float rest = 0.0f, uint16 cat = (uint16)Layers::BOARD, uint16 mask = (uint16)Layers::BALL, int angle = 0);
 	PhysBody* CreateRectangleSensor(int x, int y, int width, int height, BodyType type, uint16 cat = (uint16)Layers::SENSOR, uint16 mask = (uint16)Layers::BALL);
 	PhysBody* CreateChain(int x, int y, const int* const points, int size, BodyType type, float rest = 0.0f, uint16 cat = (uint16)Layers::BOARD, uint16 mask = (uint16)Layers::BALL, int angle = 0);
 
+	// Same from vertices already in meters (cooked colliders), count is in vertices
+	PhysBody* CreatePolygon(int x, int y, const b2Vec2 *vertices, int count, BodyType type, float rest = 0.0f, uint16 cat = (uint16)Layers::BOARD, uint16 mask = (uint16)Layers::BALL, int angle = 0);
+	PhysBody* CreateChain(int x, int y, const b2Vec2 *vertices, int count, BodyType type, float rest = 0.0f, uint16 cat = (uint16)Layers::BOARD, uint16 mask = (uint16)Layers::BALL, int angle = 0);
+
+	// Descriptors for the creators above, same defaults
+	static BodyDesc RectangleDesc(int x, int y, int width, int height, BodyType type, float32 gravityScale = 1.0f, float rest = 1.0f, uint16 cat = (uint16)Layers::BOARD, uint16 mask = (uint16)Layers::BALL);
+	static BodyDesc CircleDesc(int x, int y, int radius, BodyType type, float rest = 0.0f, uint16 cat = (uint16)Layers::BOARD, uint16 mask = (uint16)Layers::BALL, bool bullet = false);
+	static BodyDesc PolygonDesc(int x, int y, const b2Vec2 *vertices, int count, BodyType type, float rest = 0.0f, uint16 cat = (uint16)Layers::BOARD, uint16 mask = (uint16)Layers::BALL, int angle = 0);
+	static BodyDesc RectangleSensorDesc(int x, int y, int width, int height, BodyType type, uint16 cat = (uint16)Layers::SENSOR, uint16 mask = (uint16)Layers::BALL);
+	static BodyDesc ChainDesc(int x, int y, const b2Vec2 *vertices, int count, BodyType type, float rest = 0.0f, uint16 cat = (uint16)Layers::BOARD, uint16 mask = (uint16)Layers::BALL, int angle = 0);
+
+	PhysBody *CreateBody(BodyDesc const &desc);
+
+	// nullptr once the body was destroyed, even if its slot holds another one by now
+	PhysBody *GetPhysBody(PoolHandle handle) const;
+
+	// Puts the body at x,y (pixels) at rest, keeping its b2Body, fixtures and joints
+	void ResetBody(PhysBody *b, int x, int y);
+
+	// A whole level in one go: one world lock, PhysBodies from the pool, static ones
+	// baked into a body per layer. out[i] is nullptr where descs[i] couldn't be created
+	void CreateBodies(BodyDesc const *descs, size_t count, PhysBody **out);
+
+	// Joint motors and gravity, queued for the physics thread when it runs
+	void SetMotorSpeed(b2RevoluteJoint *joint, float32 speed);
+	void SetMotor(b2PrismaticJoint *joint, float32 speed, float32 maxForce);
+	void SetGravity(b2Vec2 const &newGravity);
+
+	// Holds the physics thread off the world, empty lock when stepping on the main thread
+	std::unique_lock<std::mutex> LockWorld();
+
+	// The scratch world synced to this one right now, for look-ahead. Only its moving state is
+	// copied, so forking every frame is cheap. Step it with StepFork, never with the live world's lock
+	WorldFork *Fork();
+	void StepFork(uint steps);
+
+	// Plays the last seconds of history back (drawn only, the world waits), then goes on live
+	void Replay(float seconds);
+	float GetDrainReplaySeconds() const;
+	bool IsRewinding() const;
+
 	// Create joints
 	b2RevoluteJoint *CreateRevoluteJoint(PhysBody *anchor, PhysBody *body, iPoint anchorOffset, iPoint bodyOffset, std::vector<RevoluteJointSingleProperty> properties);
 	b2PrismaticJoint *CreatePrismaticJoint(PhysBody *anchor, PhysBody *body, iPoint anchorOffset, iPoint bodyOffset, std::vector<RevoluteJointSingleProperty> properties);
@@ -144,7 +379,9 @@ public:
 	b2MouseJoint *CreateMouseJoint(b2Body *ground, b2Body *target, b2Vec2 position, float dampingRatio = 0.5f, float frequecyHz = 2.0f, float maxForce = 100.0f);
 	
 	// b2ContactListener ---
+	// Only queue the contact, listeners are called once the step is over
 	void BeginContact(b2Contact* contact) final;
+	void EndContact(b2Contact* contact) final;
 
 	// Utils
 	iPoint WorldVecToIPoint(const b2Vec2 &v) const;
@@ -154,12 +391,20 @@ public:
 
 	b2Vec2 GetWorldGravity() const;
 
-	void DestroyBody(b2Body* b = nullptr);
 	void DestroyPhysBody(PhysBody* b = nullptr);
 
+	// Safe anywhere, collision callbacks included: the body stops reporting contacts now
+	// and is destroyed (PhysBody too) right before the next step
+	void DestroyPhysBodyDeferred(PhysBody* b);
+
+	// Last finished window of the step profile, drawn by Map while F8 is on
+	StepProfileWindow GetStepProfile();
+	bool IsProfileHudActive() const;
+
 	// Get Info
 	bool IsDebugActive() const;
-	BodyType GetEnumFromStr(const std::string &s) const;
+	bool IsThreaded() const;
+	static BodyType GetEnumFromStr(const std::string &s);
 	RevoluteJoinTypes GetTypeFromProperty(const std::string &s) const;
 
 private:
@@ -167,6 +412,55 @@ private:
 	// Debug
 	void DrawDebug(const b2Body *body, const int32 count, const b2Vec2 *vertices, Uint8 r, Uint8 g, Uint8 b, Uint8 a = (Uint8)255U) const;
 
+	// The caller holds the world
+	PhysBody *CreateBodyLocked(BodyDesc const &desc);
+	b2Fixture *CreateFixtureLocked(b2Body *b, FixtureDesc const &desc, b2Transform const *placement);
+	PhysBody *AcquirePhysBody(b2Body *b, b2Fixture *fixture, BodyDesc const &desc);
+	void BakeStaticBodies(BodyDesc const *descs, size_t count, PhysBody **out);
+	void RemoveFromWorld(PhysBody *b);
+	void ConvertPoints(const int *points, int size);
+
+	// Fixed step
+	void StepWorld(float timeStep);
+	void AdvanceWorld(float timeStep);
+	void RecordProfile(StepProfile const &sample);
+	void ToggleProfileCsv();
+	uint GetSubsteps(b2World const *stepped, float timeStep) const;
+	void TrackThinnestCollider(b2Body const *b);
+	void QueueContact(b2Contact const *contact, bool begin);
+	void DispatchContactEvents();
+	void UpdateSensorOverlap(PhysBody *sensor, PhysBody *other, bool begin);
+	void ForgetContacts(PhysBody const *pBody);
+	void DestroyPendingBodies();
+
+	// Rewind: F3 scrubs back through history, F4 forward, LSHIFT+F4 goes on from the shown step
+	void CaptureHistory();
+	bool UpdateRewind();
+	void ShowHistory(uint age);
+	void ShowLive();
+	void RestoreHistory(uint age);
+
+	// Prediction: F7 draws where the balls in flight go next, stepped ahead on the fork
+	void UpdatePrediction();
+	bool IsInFlight(b2Body const *b) const;
+	void StartPrediction();
+	bool FollowPrediction(uint stepped);
+	void RecordPrediction();
+	void DrawPrediction() const;
+
+	// Physics thread
+	void StepperLoop();
+	// Runs what is queued and publishes it, under worldLock. The main thread does it too,
+	// when it can't have queued steps landing on the world behind its back
+	void FlushCommands();
+	void RunCommand(PhysicsCommand const &command);
+	void CaptureTransforms();
+	void PublishFrame();
+	void PostCommand(PhysicsCommand const &command);
+	bool IsNewMotor(PhysicsCommand const &command);
+	void ConsumeFrame();
+	void StopStepper();
+
 	// Joints
 	void DragSelectedObject();
 	bool IsMouseOverObject(b2Fixture const *f) const;
@@ -181,6 +475,108 @@ private:
 	b2World* world = nullptr;
 	b2Body *ground;
 
+	// Contacts of the current step and bodies currently inside sensors
+	std::vector<ContactEvent> contactEvents;
+	std::vector<SensorOverlap> sensorOverlaps;
+	std::vector<PhysBody*> pendingDestroy;
+
+	// Every PhysBody lives here, only the main thread acquires and releases them.
+	// Sized in config.xml, it only grows if a level needs more
+	Pool<PhysBody> bodyPool;
+
+	// Pixel point lists converted to meters, reused by every CreatePolygon and CreateChain
+	std::vector<b2Vec2> scratchVertices;
+	std::vector<b2Vec2> bakedVertices;
+
+	// Static bodies of a batch go on one body per collision layer (bake in config.xml)
+	bool bakeStatic = true;
+	bool rebuildTree = false;
+
+	// Substepping, in meters. Chains don't count: a bullet moving less than its radius can't skip a line
+	float32 thinnestCollider = b2_maxFloat;
+	uint64 fixedSteps = 0;
+	uint64 substepsTaken = 0;
+	uint maxSubstepsTaken = 0;
+	double stepMs = 0.0;
+	double dispatchMs = 0.0;
+
+	// b2World's profile of every fixed step, F8 shows it and F10 streams it to profileCsvPath.
+	// Threaded, only under worldLock
+	bool profileHud = false;
+	std::string profileCsvPath = PROFILE_DEFAULT_CSV;
+	FILE *profileCsv = nullptr;
+	StepProfile profileSum;
+	StepProfile profilePeak;
+	uint profileSteps = 0;
+	StepProfileWindow profileShown;
+
+	// Last steps of the world, written after every fixed step. Threaded, only under worldLock
+	RewindBuffer history;
+	float rewindSeconds = REWIND_DEFAULT_SECONDS;
+	uint rewindBodies = REWIND_DEFAULT_BODIES;
+	uint rewindJoints = REWIND_DEFAULT_JOINTS;
+	float drainReplaySeconds = 0.0f;
+	uint historyAge = 0;
+	bool rewinding = false;
+	bool replaying = false;
+	uint64 historyCaptures = 0;
+	double historyMs = 0.0;
+
+	// Bumped whenever a body or joint is added or removed, the fork rebuilds itself then.
+	// Atomic: the stepper bumps it destroying bodies, the prediction reads it without the lock
+	std::atomic<uint32> worldVersion{ 1 };
+	WorldFork fork;
+	uint64 forks = 0;
+	double forkMs = 0.0;
+
+	// Predicted paths, predictedPoints[step * balls + ball] in meters. Budgeted per frame: while
+	// nothing but steps happened live (liveChanges) and the balls are where the path said,
+	// the path only loses the steps taken and goes on from the same fork
+	bool predict = false;
+	float predictSeconds = PREDICTION_DEFAULT_SECONDS;
+	double predictBudgetMs = PREDICTION_DEFAULT_BUDGET_US / 1000.0;
+	uint predictCapacity = 0;
+	std::vector<PredictedBall> predictedBalls;
+	std::vector<PredictedBall> flyingBalls;
+	std::vector<b2Vec2> predictedPoints;
+	uint predictedSteps = 0;
+	bool predictionValid = false;
+	uint64 liveChanges = 0;
+	uint64 liveSteps = 0;
+	uint64 predictedChanges = 0;
+	uint64 predictedAtStep = 0;
+	uint32 predictedVersion = 0;
+	uint64 predictionsComputed = 0;
+	uint64 predictionsFollowed = 0;
+	uint64 predictionsReused = 0;
+	uint64 predictionsCut = 0;
+	uint64 predictedStepsTaken = 0;
+	uint64 predictionFrames = 0;
+	double predictMs = 0.0;
+
+	// Main thread copy, the world's one belongs to the physics thread
+	b2Vec2 gravity = b2Vec2(GRAVITY_X, -GRAVITY_Y);
+
+	// Threaded mode: the world is stepped on stepper, fed through commands
+	// and read back through the frame the stepper last published
+	bool threaded = false;
+	std::thread stepper;
+	std::atomic<bool> quitStepper{ false };
+	std::mutex worldLock;
+	std::mutex wakeLock;
+	std::condition_variable wakeUp;
+	CommandQueue<PhysicsCommand, PHYSICS_COMMAND_QUEUE_SIZE> commands;
+
+	// Last motor command posted per joint, main thread only. Cleared when motors are set
+	// without the queue (rewind, snapshots) or a destroyed body may take its joints along
+	std::unordered_map<b2Joint const *, PhysicsCommand> postedMotors;
+
+	// Double buffer: the stepper fills frames[backFrame], the main thread reads the other one
+	std::mutex frameLock;
+	PhysicsFrame frames[2];
+	uint backFrame = 0;
+	bool frameReady = false;
+
 	// Mouse Joint
 	b2Body *selected = nullptr;
 	b2MouseJoint *mouseJoint = nullptr;
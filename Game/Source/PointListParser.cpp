@@ -0,0 +1,133 @@
+#include "PointListParser.h"
+
+#include "Physics.h"
+#include "PerfTimer.h"
+#include "Log.h"
+
+#include "PugiXml/src/pugixml.hpp"
+
+#include <charconv>
+#include <regex>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+bool PointListParser::Parse(const char *begin, const char *end, float32 scale, std::vector<b2Vec2> &out)
+{
+	size_t firstPoint = out.size();
+	bool odd = false;
+
+	// Coordinates are whole pixels split by commas or whitespace, anything else (12.5) is a typo
+	auto isSeparator = [](char c) { return c == ',' || c == ' ' || c == '\t' || c == '\n' || c == '\r'; };
+
+	for(const char *p = begin; p < end;)
+	{
+		if(isSeparator(*p))
+		{
+			p++;
+			continue;
+		}
+
+		int value = 0;
+		auto [next, error] = std::from_chars(p, end, value);
+		if(error != std::errc() || (next < end && !isSeparator(*next)))
+		{
+			LOG("Bad coordinate at \"%.16s\"", p);
+			out.resize(firstPoint);
+			return false;
+		}
+		p = next;
+
+		if(!odd) out.emplace_back(scale * (float32)value, 0.0f);
+		else out.back().y = scale * (float32)value;
+		odd = !odd;
+	}
+
+	if(odd)
+	{
+		LOG("Point list has an x without its y");
+		out.resize(firstPoint);
+		return false;
+	}
+
+	return true;
+}
+
+int PointListParser::Benchmark(const char *xmlPath, uint iterations)
+{
+	pugi::xml_document collidersFile;
+	if(!collidersFile.load_file(xmlPath))
+	{
+		printf("Can't read %s\n", xmlPath);
+		return EXIT_FAILURE;
+	}
+
+	std::vector<std::string> lists;
+	size_t bytes = 0;
+	for(pugi::xml_node const &colliderNode : collidersFile.child("collider_info").children())
+	{
+		if(!colliderNode.attribute("xy")) continue;
+		lists.emplace_back(colliderNode.attribute("xy").as_string());
+		bytes += lists.back().size();
+	}
+
+	// Both have to agree before their times mean anything
+	std::vector<b2Vec2> parsed;
+	std::vector<int> tokens;
+	static const std::regex r("\\d{1,3}");
+	for(std::string const &xyStr : lists)
+	{
+		parsed.clear();
+		tokens.clear();
+		Parse(xyStr.data(), xyStr.data() + xyStr.size(), 1.0f, parsed);
+		for(std::sregex_iterator i(xyStr.begin(), xyStr.end(), r), end; i != end; ++i) tokens.push_back(stoi(i->str()));
+
+		bool same = tokens.size() == parsed.size() * 2;
+		for(size_t i = 0; same && i < parsed.size(); i++)
+		{
+			same = (int)parsed[i].x == tokens[i * 2] && (int)parsed[i].y == tokens[i * 2 + 1];
+		}
+		if(!same)
+		{
+			printf("Parsers disagree on \"%.32s...\"\n", xyStr.c_str());
+			return EXIT_FAILURE;
+		}
+	}
+
+	// The old path: one regex pass to tokenize plus two std::distance passes to count
+	size_t checksum = 0;
+	PerfTimer timer;
+	for(uint n = 0; n < iterations; n++)
+	{
+		for(std::string const &xyStr : lists)
+		{
+			auto xyStrBegin = std::sregex_iterator(xyStr.begin(), xyStr.end(), r);
+			auto xyStrEnd = std::sregex_iterator();
+			std::vector<int> points;
+			for(std::sregex_iterator i = xyStrBegin; i != xyStrEnd; ++i) points.push_back(stoi(i->str()));
+			checksum += points.size() + std::distance(xyStrBegin, xyStrEnd) + std::distance(xyStrBegin, xyStrEnd);
+		}
+	}
+	double regexMs = timer.ReadMs();
+
+	timer.Start();
+	for(uint n = 0; n < iterations; n++)
+	{
+		for(std::string const &xyStr : lists)
+		{
+			parsed.clear();
+			Parse(xyStr.data(), xyStr.data() + xyStr.size(), METER_PER_PIXEL, parsed);
+			checksum += parsed.size();
+		}
+	}
+	double fromCharsMs = timer.ReadMs();
+
+	double megabytes = (double)bytes * iterations / (1024.0 * 1024.0);
+	printf("%u point lists, %u bytes, %u iterations (checksum %u)\n", (uint)lists.size(), (uint)bytes, iterations, (uint)checksum);
+	printf("regex      %9.3f ms  %8.1f MB/s  %8.0f ns per list\n", regexMs, megabytes / (regexMs / 1000.0), regexMs * 1e6 / ((double)iterations * lists.size()));
+	printf("from_chars %9.3f ms  %8.1f MB/s  %8.0f ns per list\n", fromCharsMs, megabytes / (fromCharsMs / 1000.0), fromCharsMs * 1e6 / ((double)iterations * lists.size()));
+	printf("speedup    %9.1fx\n", regexMs / fromCharsMs);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,123 @@
+#ifndef __POOL_H__
+#define __POOL_H__
+
+#include "Defs.h"
+
+#include <memory>
+#include <stddef.h>
+#include <vector>
+
+// Names a pool slot as it was when handed out: once the slot is released
+// its generation moves on and the handle stops resolving
+struct PoolHandle
+{
+	uint32 index = 0;
+	uint32 generation = 0;
+
+	bool operator==(PoolHandle const &other) const
+	{
+		return index == other.index && generation == other.generation;
+	}
+	bool operator!=(PoolHandle const &other) const
+	{
+		return !(*this == other);
+	}
+};
+
+// Fixed address storage for objects that come and go: items live in blocks of BlockSize
+// that are never moved or freed until the pool is, released slots are handed out again.
+// Not thread safe, one owner thread.
+template<class T, size_t BlockSize = 64>
+class Pool
+{
+	static_assert(BlockSize > 0, "Pool blocks can't be empty");
+
+public:
+
+	// A default constructed item, from the free list when there is one
+	T *Acquire(PoolHandle &handle)
+	{
+		if(freeSlots.empty()) AddBlock();
+
+		uint32 index = freeSlots.back();
+		freeSlots.pop_back();
+		liveCount++;
+		peakCount = liveCount > peakCount ? liveCount : peakCount;
+
+		handle.index = index;
+		handle.generation = ++generations[index];
+
+		T *item = GetSlot(index);
+		*item = T();
+		return item;
+	}
+
+	// False, and nothing happens, for a handle that was released already
+	bool Release(PoolHandle handle)
+	{
+		if(!Get(handle)) return false;
+
+		generations[handle.index]++;
+		freeSlots.push_back(handle.index);
+		liveCount--;
+		return true;
+	}
+
+	// nullptr once the slot was released, even if it is in use again.
+	// Odd generations are live and even ones free, so a default handle never resolves
+	T *Get(PoolHandle handle) const
+	{
+		if((handle.generation & 1) == 0 || handle.index >= generations.size() || generations[handle.index] != handle.generation) return nullptr;
+		return GetSlot(handle.index);
+	}
+
+	// Grows until at least count items fit without another block
+	void Reserve(size_t count)
+	{
+		while(GetCapacity() < count) AddBlock();
+	}
+
+	size_t GetCapacity() const
+	{
+		return blocks.size() * BlockSize;
+	}
+
+	size_t GetLiveCount() const
+	{
+		return liveCount;
+	}
+
+	size_t GetPeakCount() const
+	{
+		return peakCount;
+	}
+
+private:
+
+	T *GetSlot(uint32 index) const
+	{
+		return &blocks[index / BlockSize][index % BlockSize];
+	}
+
+	void AddBlock()
+	{
+		auto first = (uint32)GetCapacity();
+		blocks.push_back(std::make_unique<T[]>(BlockSize));
+		generations.resize(GetCapacity(), 0);
+		freeSlots.reserve(GetCapacity());
+
+		// Backwards, so the first Acquire gets the first slot of the block
+		for(uint32 i = (uint32)BlockSize; i > 0; i--)
+		{
+			freeSlots.push_back(first + i - 1);
+		}
+	}
+
+	std::vector<std::unique_ptr<T[]>> blocks;
+	std::vector<uint32> generations;
+	std::vector<uint32> freeSlots;
+	size_t liveCount = 0;
+	size_t peakCount = 0;
+};
+
+#endif // __POOL_H__
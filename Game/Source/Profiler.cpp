@@ -0,0 +1,135 @@
+#include "Profiler.h"
+
+#include "Log.h"
+
+#include "SDL/include/SDL.h"
+
+#include <stdio.h>
+#include <string.h>
+
+Profiler::Profiler()
+{
+}
+
+void Profiler::SetEnabled(bool enable)
+{
+	// The history is a few MB, don't allocate it for tables that never profile
+	if(enable && !frames) frames = std::make_unique<ProfileFrame[]>(PROFILER_FRAMES);
+	enabled = enable;
+	current = nullptr;
+}
+
+bool Profiler::IsEnabled() const
+{
+	return enabled;
+}
+
+void Profiler::BeginFrame()
+{
+	if(!enabled) return;
+
+	// Overwrites the oldest frame, an unfinished previous frame (early exit) is simply reused
+	current = &frames[publishedFrames.load(std::memory_order_relaxed) % PROFILER_FRAMES];
+	current->zoneCount = 0;
+	current->start = SDL_GetPerformanceCounter();
+	current->end = current->start;
+	depth = 0;
+}
+
+void Profiler::EndFrame()
+{
+	if(!enabled || !current) return;
+
+	current->end = SDL_GetPerformanceCounter();
+	current = nullptr;
+
+	publishedFrames.fetch_add(1, std::memory_order_release);
+}
+
+void Profiler::BeginZone(const char *name, const char *category)
+{
+	if(!current) return;
+
+	// Still count the depth of a dropped zone so EndZone stays balanced
+	if(depth < PROFILER_DEPTH && current->zoneCount < PROFILER_ZONES)
+	{
+		ProfileZone &zone = current->zones[current->zoneCount];
+		strncpy_s(zone.name, PROFILER_NAME_SIZE, name, _TRUNCATE);
+		zone.category = category;
+		zone.depth = depth;
+		zone.end = 0;
+		openZones[depth] = current->zoneCount++;
+		zone.start = SDL_GetPerformanceCounter();
+	}
+	else if(depth < PROFILER_DEPTH)
+	{
+		openZones[depth] = PROFILER_ZONES;
+	}
+
+	depth++;
+}
+
+void Profiler::EndZone()
+{
+	if(!current || depth == 0) return;
+
+	depth--;
+	if(depth < PROFILER_DEPTH && openZones[depth] < PROFILER_ZONES)
+	{
+		current->zones[openZones[depth]].end = SDL_GetPerformanceCounter();
+	}
+}
+
+bool Profiler::DumpTrace(const char *path, uint frameCount) const
+{
+	if(!frames) return false;
+
+	uint64 published = publishedFrames.load(std::memory_order_acquire);
+	// The slot after the last published frame may be half written by BeginFrame
+	uint64 available = MIN(published, (uint64)PROFILER_FRAMES - 1);
+	uint64 count = MIN((uint64)frameCount, available);
+
+	if(count == 0)
+	{
+		LOG("Profiler has no finished frames to dump");
+		return false;
+	}
+
+	FILE *file = nullptr;
+	if(fopen_s(&file, path, "w") != 0 || !file)
+	{
+		LOG("Could not open %s to write the trace", path);
+		return false;
+	}
+
+	double toMicroseconds = 1000000.0 / (double)SDL_GetPerformanceFrequency();
+	uint64 first = published - count;
+	uint64 origin = frames[first % PROFILER_FRAMES].start;
+
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"Main loop\"}}");
+
+	for(uint64 i = first; i < published; i++)
+	{
+		ProfileFrame const &frame = frames[i % PROFILER_FRAMES];
+
+		fprintf(file, ",\n{\"name\":\"Frame %llu\",\"cat\":\"frame\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f}",
+				i, (double)(frame.start - origin) * toMicroseconds, (double)(frame.end - frame.start) * toMicroseconds);
+
+		for(uint z = 0; z < frame.zoneCount; z++)
+		{
+			ProfileZone const &zone = frame.zones[z];
+			uint64 end = (zone.end >= zone.start) ? zone.end : frame.end;
+
+			fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f}",
+					zone.name, zone.category ? zone.category : "zone", (double)(zone.start - origin) * toMicroseconds, (double)(end - zone.start) * toMicroseconds);
+		}
+	}
+
+	fprintf(file, "\n]}\n");
+	fclose(file);
+
+	LOG("Dumped %llu profiled frames to %s", count, path);
+
+	return true;
+}
@@ -0,0 +1,89 @@
+#ifndef __PROFILER_H__
+#define __PROFILER_H__
+
+#include "Defs.h"
+
+#include <atomic>
+#include <memory>
+
+#define PROFILER_FRAMES		300		// History kept for the trace dump
+#define PROFILER_ZONES		256		// Zones recorded per frame, extra ones are dropped
+#define PROFILER_DEPTH		16		// Max nesting of zones
+#define PROFILER_NAME_SIZE	32
+
+struct ProfileZone
+{
+	char name[PROFILER_NAME_SIZE];
+	const char *category = nullptr;
+	uint64 start = 0;
+	uint64 end = 0;
+	uint depth = 0;
+};
+
+struct ProfileFrame
+{
+	uint64 start = 0;
+	uint64 end = 0;
+	uint zoneCount = 0;
+	ProfileZone zones[PROFILER_ZONES];
+};
+
+// Records timing zones of the last PROFILER_FRAMES frames in a ring buffer.
+// Only the main loop thread writes; a finished frame is published through an atomic counter
+// so the frames older than it can be read without locking.
+class Profiler
+{
+public:
+
+	Profiler();
+
+	void SetEnabled(bool enable);
+	bool IsEnabled() const;
+
+	void BeginFrame();
+	void EndFrame();
+
+	// Zones nest: EndZone closes the last zone opened
+	void BeginZone(const char *name, const char *category);
+	void EndZone();
+
+	// Write the last frameCount frames as a Chrome trace_event file (chrome://tracing, ui.perfetto.dev)
+	bool DumpTrace(const char *path, uint frameCount = PROFILER_FRAMES) const;
+
+private:
+
+	std::unique_ptr<ProfileFrame[]> frames;
+	std::atomic<uint64> publishedFrames{ 0 };
+	ProfileFrame *current = nullptr;
+
+	uint openZones[PROFILER_DEPTH];
+	uint depth = 0;
+
+	bool enabled = false;
+};
+
+// Opens a zone for the rest of the scope
+class ProfileScope
+{
+public:
+
+	ProfileScope(Profiler *profiler, const char *name, const char *category) : profiler(profiler)
+	{
+		if(profiler) profiler->BeginZone(name, category);
+	}
+
+	~ProfileScope()
+	{
+		if(profiler) profiler->EndZone();
+	}
+
+private:
+
+	Profiler *profiler;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(profiler, name, category) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(profiler, name, category)
+
+#endif // __PROFILER_H__
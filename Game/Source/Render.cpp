@@ -2,13 +2,14 @@
 #include "Window.h"
 #include "Render.h"
 #include "Input.h"
+#include "Profiler.h"
 
 #include "Defs.h"
 #include "Log.h"
 
 #define VSYNC false
 
-Render::Render() : Module()
+Render::Render(App* app) : Module(app)
 {
 	name.Create("renderer");
 	background.r = 0;
@@ -49,7 +50,7 @@ bool Render::Awake(pugi::xml_node& config)
 	camera.x = 0;
 	camera.y = 0;
 
-	ticksForNextFrame = 1000 / fpsTarget;
+	pacer.SetTargetFps(fpsTarget);
 	
 	return true;
 }
@@ -71,13 +72,7 @@ bool Render::PreUpdate()
 		vSyncOnRestart = !vSyncOnRestart;
 		app->SaveToConfig(name.GetString(), "vsync", "value", vSyncOnRestart ? "true" : "false");
 	}
-	if(!vSyncMode)
-	{
-		while(SDL_GetTicks() - lastTime < ticksForNextFrame)
-		{
-			SDL_Delay(1);
-		}
-	}
+	if(!vSyncMode) pacer.Wait();
 	SDL_RenderClear(renderer);
 	return true;
 }
@@ -87,12 +82,12 @@ bool Render::Update(float dt)
 	if (app->input->GetKey(SDL_SCANCODE_I) == KEY_DOWN && fpsTarget < 1000)
 	{
 		fpsTarget += 10; 
-		ticksForNextFrame = 1000 / fpsTarget;
+		pacer.SetTargetFps(fpsTarget);
 	}
 	if (app->input->GetKey(SDL_SCANCODE_O) == KEY_DOWN && fpsTarget > 10)
 	{
 		fpsTarget -= 10;
-		ticksForNextFrame = 1000 / fpsTarget;
+		pacer.SetTargetFps(fpsTarget);
 	}
 	return true;
 }
@@ -100,9 +95,10 @@ bool Render::Update(float dt)
 bool Render::PostUpdate()
 {
 	SDL_SetRenderDrawColor(renderer, background.r, background.g, background.g, background.a);
-	SDL_RenderPresent(renderer);
-	
-	if(!vSyncMode) lastTime = SDL_GetTicks();
+	{
+		PROFILE_SCOPE(app->profiler, "SDL_RenderPresent", "render");
+		SDL_RenderPresent(renderer);
+	}
 
 	fpsFrames++;
 	if (fpsLastTime < (SDL_GetTicks() - FPS_INTERVAL * 1000))
@@ -118,6 +114,12 @@ bool Render::PostUpdate()
 // Called before quitting
 bool Render::CleanUp()
 {
+	if(!vSyncMode)
+	{
+		FramePacingStats stats = pacer.GetTotalStats();
+		LOG("Frame pacing at %u fps: %u frames, jitter avg %.1f us max %.1f us, %u missed", fpsTarget, stats.frames, stats.avgJitterUs, stats.maxJitterUs, stats.missed);
+	}
+
 	LOG("Destroying SDL render");
 	SDL_DestroyRenderer(renderer);
 	return true;
@@ -288,6 +290,11 @@ uint Render::GetTargetFPS() const
 	return fpsTarget;
 }
 
+FramePacingStats Render::GetPacingStats() const
+{
+	return pacer.GetLastSecondStats();
+}
+
 bool Render::IsVSyncActive() const
 {
 	return vSyncMode;
@@ -4,6 +4,7 @@
 #include "Module.h"
 
 #include "Point.h"
+#include "FramePacer.h"
 
 #include "PugiXml/src/pugixml.hpp"
 #include "SDL/include/SDL.h"
@@ -12,7 +13,7 @@ class Render : public Module
 {
 public:
 
-	Render();
+	explicit Render(App* app);
 
 	// Destructor
 	virtual ~Render();
@@ -50,6 +51,7 @@ public:
 	uint GetTargetFPS() const;
 	bool IsVSyncActive() const;
 	bool RestartForVSync() const;
+	FramePacingStats GetPacingStats() const;
 
 	SDL_Renderer* renderer;
 	SDL_Rect camera;
@@ -65,9 +67,8 @@ private:
 	uint fpsCurrent = 0;
 	uint fpsFrames = 0;
 
-	uint lastTime = 0;
 	uint fpsTarget = 60;
-	uint ticksForNextFrame = 1000;
+	FramePacer pacer;
 };
 
 #endif // __RENDER_H__
\ No newline at end of file
@@ -0,0 +1,128 @@
+#include "RewindBuffer.h"
+
+#include "Physics.h"
+
+void RewindBuffer::Allocate(uint frameCount, uint bodiesEach, uint jointsEach)
+{
+	frames.assign(frameCount, RewindFrame());
+	bodies.assign((size_t)frameCount * bodiesEach, RewindBody());
+	joints.assign((size_t)frameCount * jointsEach, RewindJoint());
+	bodiesPerFrame = bodiesEach;
+	jointsPerFrame = jointsEach;
+	Clear();
+}
+
+void RewindBuffer::Capture(b2World const *world, b2Vec2 const &gravity)
+{
+	if(frames.empty()) return;
+
+	RewindFrame &frame = frames[head];
+	frame.gravity = gravity;
+	frame.bodyCount = 0;
+	frame.jointCount = 0;
+	frame.complete = true;
+
+	RewindBody *bodySlots = &bodies[(size_t)head * bodiesPerFrame];
+	for(b2Body const *b = world->GetBodyList(); b; b = b->GetNext())
+	{
+		if(b->GetType() == b2_staticBody) continue;
+
+		auto *pb = (PhysBody *)b->GetUserData();
+		if(!pb) continue;
+
+		if(frame.bodyCount == bodiesPerFrame)
+		{
+			frame.complete = false;
+			break;
+		}
+
+		RewindBody &slot = bodySlots[frame.bodyCount++];
+		slot.body = pb;
+		slot.handle = pb->handle;
+		slot.transform = b->GetTransform();
+		slot.linearVelocity = b->GetLinearVelocity();
+		slot.angularVelocity = b->GetAngularVelocity();
+		slot.awake = b->IsAwake();
+	}
+
+	RewindJoint *jointSlots = joints.empty() ? nullptr : &joints[(size_t)head * jointsPerFrame];
+	for(b2Joint const *j = world->GetJointList(); j; j = j->GetNext())
+	{
+		float32 speed = 0.0f;
+		float32 force = 0.0f;
+		switch(j->GetType())
+		{
+			case e_revoluteJoint:
+				speed = ((b2RevoluteJoint const *)j)->GetMotorSpeed();
+				break;
+			case e_prismaticJoint:
+				speed = ((b2PrismaticJoint const *)j)->GetMotorSpeed();
+				force = ((b2PrismaticJoint const *)j)->GetMaxMotorForce();
+				break;
+			default:
+				continue;
+		}
+
+		if(frame.jointCount == jointsPerFrame)
+		{
+			frame.complete = false;
+			break;
+		}
+
+		RewindJoint &slot = jointSlots[frame.jointCount++];
+		slot.joint = const_cast<b2Joint *>(j);
+		slot.motorSpeed = speed;
+		slot.maxMotorForce = force;
+	}
+
+	head = (head + 1) % (uint)frames.size();
+	if(count < frames.size()) count++;
+}
+
+void RewindBuffer::DropNewest(uint dropped)
+{
+	dropped = dropped < count ? dropped : count;
+	head = (head + (uint)frames.size() - dropped) % (uint)frames.size();
+	count -= dropped;
+}
+
+void RewindBuffer::Clear()
+{
+	head = 0;
+	count = 0;
+}
+
+RewindFrame const *RewindBuffer::GetFrame(uint age) const
+{
+	return age < count ? &frames[GetSlot(age)] : nullptr;
+}
+
+RewindBody const *RewindBuffer::GetBodies(uint age) const
+{
+	return age < count ? &bodies[(size_t)GetSlot(age) * bodiesPerFrame] : nullptr;
+}
+
+RewindJoint const *RewindBuffer::GetJoints(uint age) const
+{
+	return age < count && jointsPerFrame > 0 ? &joints[(size_t)GetSlot(age) * jointsPerFrame] : nullptr;
+}
+
+uint RewindBuffer::GetCount() const
+{
+	return count;
+}
+
+uint RewindBuffer::GetCapacity() const
+{
+	return (uint)frames.size();
+}
+
+size_t RewindBuffer::GetBytes() const
+{
+	return frames.size() * sizeof(RewindFrame) + bodies.size() * sizeof(RewindBody) + joints.size() * sizeof(RewindJoint);
+}
+
+uint RewindBuffer::GetSlot(uint age) const
+{
+	return (head + (uint)frames.size() - 1 - age) % (uint)frames.size();
+}
@@ -0,0 +1,80 @@
+#ifndef __REWINDBUFFER_H__
+#define __REWINDBUFFER_H__
+
+#include "Defs.h"
+#include "Pool.h"
+
+#include "Box2D/Box2D/Box2D.h"
+
+#include <vector>
+
+class PhysBody;
+
+// A moving body as it was after a step. Static ones never change and aren't kept
+struct RewindBody
+{
+	PhysBody *body = nullptr;
+	PoolHandle handle;
+	b2Transform transform;
+	b2Vec2 linearVelocity;
+	float32 angularVelocity = 0.0f;
+	bool awake = true;
+};
+
+// The motor of a joint, the only part of it the game changes
+struct RewindJoint
+{
+	b2Joint *joint = nullptr;
+	float32 motorSpeed = 0.0f;
+	float32 maxMotorForce = 0.0f;
+};
+
+struct RewindFrame
+{
+	b2Vec2 gravity;
+	uint bodyCount = 0;
+	uint jointCount = 0;
+
+	// False when the world had more bodies or joints than a frame holds
+	bool complete = true;
+};
+
+// The last N fixed steps of the world. Everything is allocated once by Allocate:
+// each frame owns a fixed run of body and joint slots, Capture only overwrites the oldest
+class RewindBuffer
+{
+public:
+
+	void Allocate(uint frames, uint bodiesPerFrame, uint jointsPerFrame);
+
+	void Capture(b2World const *world, b2Vec2 const &gravity);
+
+	// Forgets the count newest frames, to go on from an older one
+	void DropNewest(uint count);
+	void Clear();
+
+	// age 0 is the newest frame, GetCount() - 1 the oldest
+	RewindFrame const *GetFrame(uint age) const;
+	RewindBody const *GetBodies(uint age) const;
+	RewindJoint const *GetJoints(uint age) const;
+
+	uint GetCount() const;
+	uint GetCapacity() const;
+	size_t GetBytes() const;
+
+private:
+
+	uint GetSlot(uint age) const;
+
+	std::vector<RewindFrame> frames;
+	std::vector<RewindBody> bodies;
+	std::vector<RewindJoint> joints;
+	uint bodiesPerFrame = 0;
+	uint jointsPerFrame = 0;
+
+	// Next slot to write and how many are filled
+	uint head = 0;
+	uint count = 0;
+};
+
+#endif // __REWINDBUFFER_H__
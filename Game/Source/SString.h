@@ -48,8 +48,9 @@ public:
 
 		if (format != NULL)
 		{
-			static char tmp[TMP_STRING_SIZE];
-			static va_list  ap;
+			// Locals, modules of different tables are named from different threads
+			char tmp[TMP_STRING_SIZE];
+			va_list ap;
 
 			// Construct the string from variable arguments
 			va_start(ap, format);
@@ -83,8 +84,9 @@ public:
 
 		if (format != NULL)
 		{
-			static char tmp[TMP_STRING_SIZE];
-			static va_list  ap;
+			// Locals, modules of different tables are named from different threads
+			char tmp[TMP_STRING_SIZE];
+			va_list ap;
 
 			// Construct the string from variable arguments
 			va_start(ap, format);
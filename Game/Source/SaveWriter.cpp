@@ -0,0 +1,162 @@
+#include "SaveWriter.h"
+
+#include "Log.h"
+
+#include "SDL/include/SDL.h"
+
+#include <algorithm>
+#include <stdio.h>
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+SaveWriter::~SaveWriter()
+{
+	if(!writer.joinable()) return;
+
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		quit = true;
+	}
+	wakeUp.notify_one();
+	writer.join();
+}
+
+void SaveWriter::Submit(std::unique_ptr<pugi::xml_document> document, std::string const &path, Callback onComplete)
+{
+	Job job;
+	job.document = std::move(document);
+	job.path = path;
+	job.onComplete = std::move(onComplete);
+	Enqueue(std::move(job));
+}
+
+void SaveWriter::Submit(std::vector<char> bytes, std::string const &path, Callback onComplete)
+{
+	Job job;
+	job.bytes = std::move(bytes);
+	job.path = path;
+	job.onComplete = std::move(onComplete);
+	Enqueue(std::move(job));
+}
+
+void SaveWriter::Enqueue(Job job)
+{
+	{
+		std::lock_guard<std::mutex> guard(lock);
+
+		// The thread is only started by the first save, most headless tables never save
+		if(!writer.joinable()) writer = std::thread(&SaveWriter::WriterLoop, this);
+
+		auto samePath = std::find_if(pending.begin(), pending.end(), [&job](Job const &queued) { return queued.path == job.path; });
+		if(samePath != pending.end()) *samePath = std::move(job);
+		else pending.push_back(std::move(job));
+	}
+	wakeUp.notify_one();
+}
+
+void SaveWriter::DispatchCompleted()
+{
+	std::vector<Completed> finished;
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		if(completed.empty()) return;
+		finished.swap(completed);
+	}
+
+	for(auto const &save : finished)
+	{
+		if(save.onComplete) save.onComplete(save.result);
+	}
+}
+
+void SaveWriter::Flush()
+{
+	std::unique_lock<std::mutex> guard(lock);
+	idle.wait(guard, [this]() { return pending.empty() && !writing; });
+}
+
+void SaveWriter::WriterLoop()
+{
+	std::unique_lock<std::mutex> guard(lock);
+
+	while(true)
+	{
+		wakeUp.wait(guard, [this]() { return quit || !pending.empty(); });
+		if(pending.empty() && quit) break;
+
+		Job job = std::move(pending.front());
+		pending.erase(pending.begin());
+		writing = true;
+
+		guard.unlock();
+
+		uint64 start = SDL_GetPerformanceCounter();
+		SaveResult result;
+		result.path = job.path;
+		result.success = WriteAtomically(job);
+		result.writeMs = (double)(SDL_GetPerformanceCounter() - start) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+		job.document.reset();
+		job.bytes.clear();
+
+		guard.lock();
+
+		completed.push_back({ result, std::move(job.onComplete) });
+		writing = false;
+		idle.notify_all();
+	}
+}
+
+bool SaveWriter::WriteAtomically(Job const &job)
+{
+	if(!job.document) return WriteAtomically(job.bytes, job.path);
+
+	std::string tempPath = job.path + ".tmp";
+	if(!job.document->save_file(tempPath.c_str()))
+	{
+		LOG("Could not write %s", tempPath.c_str());
+		remove(tempPath.c_str());
+		return false;
+	}
+
+	return ReplaceWithTemp(tempPath, job.path);
+}
+
+bool SaveWriter::WriteAtomically(std::vector<char> const &bytes, std::string const &path)
+{
+	std::string tempPath = path + ".tmp";
+
+	bool written = false;
+	FILE *file = nullptr;
+	if(fopen_s(&file, tempPath.c_str(), "wb") == 0 && file)
+	{
+		written = fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+		written = (fclose(file) == 0) && written;
+	}
+
+	if(!written)
+	{
+		LOG("Could not write %s", tempPath.c_str());
+		remove(tempPath.c_str());
+		return false;
+	}
+
+	return ReplaceWithTemp(tempPath, path);
+}
+
+bool SaveWriter::ReplaceWithTemp(std::string const &tempPath, std::string const &path)
+{
+#ifdef _WIN32
+	bool renamed = MoveFileExA(tempPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+	bool renamed = rename(tempPath.c_str(), path.c_str()) == 0;
+#endif
+
+	if(!renamed)
+	{
+		LOG("Could not replace %s with %s", path.c_str(), tempPath.c_str());
+		remove(tempPath.c_str());
+	}
+
+	return renamed;
+}
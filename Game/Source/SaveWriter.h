@@ -0,0 +1,83 @@
+#ifndef __SAVEWRITER_H__
+#define __SAVEWRITER_H__
+
+#include "Defs.h"
+
+#include "PugiXml/src/pugixml.hpp"
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct SaveResult
+{
+	std::string path;
+	bool success = false;
+	double writeMs = 0.0;
+};
+
+// Writes save documents to disk on a background thread.
+// The main thread only hands over a document it already filled; the writer serializes it to
+// a temp file and renames it over the target, so a crash never leaves a half written save.
+class SaveWriter
+{
+public:
+
+	using Callback = std::function<void(SaveResult const &)>;
+
+	SaveWriter() = default;
+	~SaveWriter();
+
+	// Takes ownership of the document. If a save to the same path is still waiting, it is replaced
+	void Submit(std::unique_ptr<pugi::xml_document> document, std::string const &path, Callback onComplete = nullptr);
+
+	// Same for a binary blob (snapshots)
+	void Submit(std::vector<char> bytes, std::string const &path, Callback onComplete = nullptr);
+
+	// Runs the callbacks of finished saves, call it from the main thread
+	void DispatchCompleted();
+
+	// Block until every submitted save is on disk
+	void Flush();
+
+	// Same temp file and rename, on the calling thread, for files needed right away
+	static bool WriteAtomically(std::vector<char> const &bytes, std::string const &path);
+
+private:
+
+	// Either a document or bytes
+	struct Job
+	{
+		std::unique_ptr<pugi::xml_document> document;
+		std::vector<char> bytes;
+		std::string path;
+		Callback onComplete;
+	};
+
+	struct Completed
+	{
+		SaveResult result;
+		Callback onComplete;
+	};
+
+	void Enqueue(Job job);
+	void WriterLoop();
+	static bool WriteAtomically(Job const &job);
+	static bool ReplaceWithTemp(std::string const &tempPath, std::string const &path);
+
+	std::thread writer;
+	std::mutex lock;
+	std::condition_variable wakeUp;
+	std::condition_variable idle;
+
+	std::vector<Job> pending;
+	std::vector<Completed> completed;
+	bool writing = false;
+	bool quit = false;
+};
+
+#endif // __SAVEWRITER_H__
@@ -11,7 +11,7 @@
 #include "Defs.h"
 #include "Log.h"
 
-Scene::Scene() : Module()
+Scene::Scene(App* app) : Module(app)
 {
 	name.Create("scene");
 }
@@ -40,7 +40,7 @@ bool Scene::Start()
 
 	SString title("Pinball");
 
-	app->win->SetTitle(title.GetString());
+	if(app->win) app->win->SetTitle(title.GetString());
 
 	return true;
 }
@@ -11,7 +11,7 @@ class Scene : public Module
 {
 public:
 
-	Scene();
+	explicit Scene(App* app);
 
 	// Destructor
 	virtual ~Scene();
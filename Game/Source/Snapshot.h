@@ -0,0 +1,128 @@
+#ifndef __SNAPSHOT_H__
+#define __SNAPSHOT_H__
+
+#include "Defs.h"
+
+#include <string.h>
+#include <type_traits>
+#include <vector>
+
+#define SNAPSHOT_MAGIC		0x4E534250	// "PBSN"
+#define SNAPSHOT_VERSION	2
+
+struct SnapshotHeader
+{
+	uint32 magic = SNAPSHOT_MAGIC;
+	uint32 version = SNAPSHOT_VERSION;
+	uint32 sections = 0;
+	uint32 payloadSize = 0;
+};
+
+// Appends plain data to a byte buffer, one memcpy per value
+class SnapshotWriter
+{
+public:
+
+	template<class T>
+	void Write(T const &value)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "Snapshots only hold plain data");
+		size_t offset = buffer.size();
+		buffer.resize(offset + sizeof(T));
+		memcpy(&buffer[offset], &value, sizeof(T));
+	}
+
+	// Reserve room for a value written later (section sizes)
+	size_t Skip(size_t bytes)
+	{
+		size_t offset = buffer.size();
+		buffer.resize(offset + bytes);
+		return offset;
+	}
+
+	template<class T>
+	void WriteAt(size_t offset, T const &value)
+	{
+		memcpy(&buffer[offset], &value, sizeof(T));
+	}
+
+	size_t Size() const
+	{
+		return buffer.size();
+	}
+
+	void Reserve(size_t bytes)
+	{
+		buffer.reserve(bytes);
+	}
+
+	std::vector<char> &GetBuffer()
+	{
+		return buffer;
+	}
+
+private:
+
+	std::vector<char> buffer;
+};
+
+// Reads values back in the order they were written. Any read past the end fails and keeps failing
+class SnapshotReader
+{
+public:
+
+	SnapshotReader(const char *data, size_t size) : data(data), size(size) {}
+
+	template<class T>
+	bool Read(T &value)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "Snapshots only hold plain data");
+		if(failed || offset + sizeof(T) > size)
+		{
+			failed = true;
+			return false;
+		}
+		memcpy(&value, data + offset, sizeof(T));
+		offset += sizeof(T);
+		return true;
+	}
+
+	bool Skip(size_t bytes)
+	{
+		if(failed || offset + bytes > size)
+		{
+			failed = true;
+			return false;
+		}
+		offset += bytes;
+		return true;
+	}
+
+	// Hands the next bytes to a reader of their own and skips past them
+	bool Split(size_t bytes, SnapshotReader &section)
+	{
+		const char *start = data + offset;
+		if(!Skip(bytes)) return false;
+		section = SnapshotReader(start, bytes);
+		return true;
+	}
+
+	size_t GetOffset() const
+	{
+		return offset;
+	}
+
+	bool Failed() const
+	{
+		return failed;
+	}
+
+private:
+
+	const char *data = nullptr;
+	size_t size = 0;
+	size_t offset = 0;
+	bool failed = false;
+};
+
+#endif // __SNAPSHOT_H__
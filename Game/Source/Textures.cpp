@@ -1,6 +1,7 @@
 #include "App.h"
 #include "Render.h"
 #include "Textures.h"
+#include "PerfTimer.h"
 
 #include "Defs.h"
 #include "Log.h"
@@ -8,7 +9,7 @@
 #include "SDL_image/include/SDL_image.h"
 //#pragma comment(lib, "../Game/Source/External/SDL_image/libx86/SDL2_image.lib")
 
-Textures::Textures() : Module()
+Textures::Textures(App* app) : Module(app)
 {
 	name.Create("textures");
 }
@@ -60,6 +61,8 @@ bool Textures::CleanUp()
 // Load new texture from file path
 SDL_Texture* Textures::Load(const char* path) 
 {
+	PERF_ZONE("Textures::Load");
+
 	SDL_Surface* surface = IMG_Load(path);
 
 	if(!surface)
@@ -12,7 +12,7 @@ class Textures : public Module
 {
 public:
 
-	Textures();
+	explicit Textures(App* app);
 
 	// Destructor
 	virtual ~Textures();
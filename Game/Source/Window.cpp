@@ -7,7 +7,7 @@
 #include "SDL/include/SDL.h"
 
 
-Window::Window() : Module()
+Window::Window(App* app) : Module(app)
 {
 	name.Create("window");
 }
@@ -10,7 +10,7 @@ class Window : public Module
 {
 public:
 
-	Window();
+	explicit Window(App* app);
 
 	// Destructor
 	virtual ~Window();
@@ -0,0 +1,177 @@
+#include "WorldFork.h"
+
+#include "Log.h"
+
+WorldFork::~WorldFork()
+{
+	Destroy();
+}
+
+void WorldFork::Destroy()
+{
+	RELEASE(world)
+	bodies.clear();
+	joints.clear();
+}
+
+void WorldFork::Sync(b2World const *live, uint32 version)
+{
+	if(!world || version != builtVersion)
+	{
+		Build(live);
+		builtVersion = version;
+	}
+
+	world->SetGravity(live->GetGravity());
+
+	for(BodyMirror const &mirror : bodies)
+	{
+		b2Body const *from = mirror.live;
+		b2Body *to = mirror.copy;
+
+		// SetTransform touches the broadphase, skip bodies that didn't move since the last sync
+		if(!(to->GetPosition() == from->GetPosition()) || to->GetAngle() != from->GetAngle())
+		{
+			to->SetTransform(from->GetPosition(), from->GetAngle());
+		}
+		to->SetLinearVelocity(from->GetLinearVelocity());
+		to->SetAngularVelocity(from->GetAngularVelocity());
+		to->SetAwake(from->IsAwake());
+	}
+
+	for(JointMirror const &mirror : joints)
+	{
+		if(mirror.live->GetType() == e_revoluteJoint)
+		{
+			((b2RevoluteJoint *)mirror.copy)->SetMotorSpeed(((b2RevoluteJoint const *)mirror.live)->GetMotorSpeed());
+		}
+		else
+		{
+			auto const *from = (b2PrismaticJoint const *)mirror.live;
+			((b2PrismaticJoint *)mirror.copy)->SetMotorSpeed(from->GetMotorSpeed());
+			((b2PrismaticJoint *)mirror.copy)->SetMaxMotorForce(from->GetMaxMotorForce());
+		}
+	}
+}
+
+void WorldFork::Build(b2World const *live)
+{
+	Destroy();
+	builds++;
+
+	world = new b2World(live->GetGravity());
+
+	// Joints hang from static anchors too, so every body is looked up here while building
+	std::vector<BodyMirror> built;
+	auto findMirror = [&built](b2Body const *from) -> b2Body * {
+		for(BodyMirror const &mirror : built)
+		{
+			if(mirror.live == from) return mirror.copy;
+		}
+		return nullptr;
+	};
+
+	for(b2Body const *b = live->GetBodyList(); b; b = b->GetNext())
+	{
+		b2BodyDef def;
+		def.type = b->GetType();
+		def.position = b->GetPosition();
+		def.angle = b->GetAngle();
+		def.linearVelocity = b->GetLinearVelocity();
+		def.angularVelocity = b->GetAngularVelocity();
+		def.linearDamping = b->GetLinearDamping();
+		def.angularDamping = b->GetAngularDamping();
+		def.gravityScale = b->GetGravityScale();
+		def.bullet = b->IsBullet();
+		def.fixedRotation = b->IsFixedRotation();
+		def.awake = b->IsAwake();
+		def.active = b->IsActive();
+		def.userData = b->GetUserData();
+
+		b2Body *copy = world->CreateBody(&def);
+
+		// CreateFixture clones the shape into the fork's own allocator
+		for(b2Fixture const *f = b->GetFixtureList(); f; f = f->GetNext())
+		{
+			b2FixtureDef fixture;
+			fixture.shape = f->GetShape();
+			fixture.density = f->GetDensity();
+			fixture.friction = f->GetFriction();
+			fixture.restitution = f->GetRestitution();
+			fixture.isSensor = f->IsSensor();
+			fixture.filter = f->GetFilterData();
+			fixture.userData = f->GetUserData();
+			copy->CreateFixture(&fixture);
+		}
+
+		built.push_back({ b, copy });
+		if(b->GetType() != b2_staticBody) bodies.push_back({ b, copy });
+	}
+
+	// Only the joints the table is made of, a mouse joint is the player's hand
+	for(b2Joint const *j = live->GetJointList(); j; j = j->GetNext())
+	{
+		b2Joint *copy = nullptr;
+
+		if(j->GetType() == e_revoluteJoint)
+		{
+			auto const *from = (b2RevoluteJoint const *)j;
+			b2RevoluteJointDef def;
+			def.bodyA = findMirror(from->GetBodyA());
+			def.bodyB = findMirror(from->GetBodyB());
+			def.collideConnected = from->GetCollideConnected();
+			def.localAnchorA = from->GetLocalAnchorA();
+			def.localAnchorB = from->GetLocalAnchorB();
+			def.referenceAngle = from->GetReferenceAngle();
+			def.enableLimit = from->IsLimitEnabled();
+			def.lowerAngle = from->GetLowerLimit();
+			def.upperAngle = from->GetUpperLimit();
+			def.enableMotor = from->IsMotorEnabled();
+			def.motorSpeed = from->GetMotorSpeed();
+			def.maxMotorTorque = from->GetMaxMotorTorque();
+			if(def.bodyA && def.bodyB) copy = world->CreateJoint(&def);
+		}
+		else if(j->GetType() == e_prismaticJoint)
+		{
+			auto const *from = (b2PrismaticJoint const *)j;
+			b2PrismaticJointDef def;
+			def.bodyA = findMirror(from->GetBodyA());
+			def.bodyB = findMirror(from->GetBodyB());
+			def.collideConnected = from->GetCollideConnected();
+			def.localAnchorA = from->GetLocalAnchorA();
+			def.localAnchorB = from->GetLocalAnchorB();
+			def.localAxisA = from->GetLocalAxisA();
+			def.referenceAngle = from->GetReferenceAngle();
+			def.enableLimit = from->IsLimitEnabled();
+			def.lowerTranslation = from->GetLowerLimit();
+			def.upperTranslation = from->GetUpperLimit();
+			def.enableMotor = from->IsMotorEnabled();
+			def.motorSpeed = from->GetMotorSpeed();
+			def.maxMotorForce = from->GetMaxMotorForce();
+			if(def.bodyA && def.bodyB) copy = world->CreateJoint(&def);
+		}
+
+		if(copy) joints.push_back({ j, copy });
+	}
+
+	LOG("World fork built: %d bodies, %u of them moving, %u joints", world->GetBodyCount(), (uint)bodies.size(), (uint)joints.size());
+}
+
+b2Body *WorldFork::GetBody(PhysBody const *pBody) const
+{
+	for(BodyMirror const &mirror : bodies)
+	{
+		if(mirror.copy->GetUserData() == pBody) return mirror.copy;
+	}
+	return nullptr;
+}
+
+b2World *WorldFork::GetWorld() const
+{
+	return world;
+}
+
+uint WorldFork::GetBuilds() const
+{
+	return builds;
+}
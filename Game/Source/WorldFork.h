@@ -0,0 +1,61 @@
+#ifndef __WORLDFORK_H__
+#define __WORLDFORK_H__
+
+#include "Defs.h"
+
+#include "Box2D/Box2D/Box2D.h"
+
+#include <vector>
+
+class PhysBody;
+
+// A scratch b2World that mirrors the live one, to step ahead without touching it.
+// Bodies, fixtures and joints are copied once and kept: a Sync only copies what moves
+// (transforms, velocities, motors), so forking every frame allocates nothing.
+// The copy is built again only when the live world gets or loses a body or joint.
+// Main thread only; mirror bodies keep the live PhysBody as user data, fixtures the live fixture's.
+class WorldFork
+{
+public:
+
+	WorldFork() = default;
+	~WorldFork();
+
+	WorldFork(WorldFork const &) = delete;
+	WorldFork &operator=(WorldFork const &) = delete;
+
+	// The caller holds the live world. version changes whenever its bodies or joints do
+	void Sync(b2World const *live, uint32 version);
+
+	// The mirror of a live body, nullptr for static ones and bodies the fork doesn't know
+	b2Body *GetBody(PhysBody const *pBody) const;
+
+	b2World *GetWorld() const;
+	uint GetBuilds() const;
+
+	void Destroy();
+
+private:
+
+	void Build(b2World const *live);
+
+	// Live and mirror pairs that move, static geometry is only built
+	struct BodyMirror
+	{
+		b2Body const *live;
+		b2Body *copy;
+	};
+	struct JointMirror
+	{
+		b2Joint const *live;
+		b2Joint *copy;
+	};
+
+	b2World *world = nullptr;
+	std::vector<BodyMirror> bodies;
+	std::vector<JointMirror> joints;
+	uint32 builtVersion = 0;
+	uint builds = 0;
+};
+
+#endif // __WORLDFORK_H__